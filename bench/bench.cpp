@@ -0,0 +1,277 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <cstring>
+#include <cstdio>
+using namespace std;
+
+#include "opensse/opensse.h"
+#include "synthetic.h"
+
+using namespace sse;
+
+void usages() {
+    cout << "Usages: bench [-o output] [-b benchmarks] [-n images] [-d documents] [-q queries] [-s seed] [-l label]" <<endl
+         << "  Benchmarks feature extraction, quantization, clustering and the inverted index on synthetic data" <<endl
+         << "  The options are as follows:" <<endl
+         << "  -o\t \033[4moutput\033[0m JSON file, default: bench.json" <<endl
+         << "  -b\t comma separated list of galif, quantize, kmeans, index, default: all of them" <<endl
+         << "  -n\t number of synthetic sketches, default: 64" <<endl
+         << "  -d\t largest index size, the index is benchmarked at 10^4, 10^5, ... documents up to it, default: 100000" <<endl
+         << "  -q\t number of queries per index size, default: 100" <<endl
+         << "  -s\t seed of the synthetic data, default: " << DefaultSeed <<endl
+         << "  -l\t label stored with the results, e.g. the commit" <<endl;
+}
+
+typedef chrono::steady_clock Clock_t;
+
+inline double millisecondsSince(const Clock_t::time_point &start)
+{
+    return chrono::duration<double, milli>(Clock_t::now() - start).count();
+}
+
+/**
+ * Times of the runs of one benchmark, written as one JSON object.
+ * params is a JSON object of whatever describes the configuration.
+ */
+struct Result
+{
+    string name;
+    string params;
+    vector<double> ms;
+
+    Result(const string &name, const string &params) : name(name), params(params) {}
+
+    void write(ostream &out) const
+    {
+        vector<double> sorted(ms);
+        sort(sorted.begin(), sorted.end());
+        double sum = 0;
+        for(size_t i = 0; i < sorted.size(); i++) sum += sorted[i];
+
+        out << "{\"name\":\"" << name << "\",\"params\":" << params << ",\"runs\":" << sorted.size();
+        if(!sorted.empty()) {
+            out << ",\"mean_ms\":" << sum / sorted.size()
+                << ",\"median_ms\":" << sorted[sorted.size() / 2]
+                << ",\"min_ms\":" << sorted.front()
+                << ",\"max_ms\":" << sorted.back();
+        }
+        out << "}";
+    }
+};
+
+struct Options
+{
+    uint numOfImages;
+    uint maxDocuments;
+    uint numOfQueries;
+    unsigned int seed;
+};
+
+// Galif::compute per image, features receives those of every image
+void benchGalif(const Options &options, const Galif &galif, vector<Result> &results, vector<Features_t> &features)
+{
+    vector<cv::Mat> images(options.numOfImages);
+    for(uint i = 0; i < images.size(); i++) images[i] = syntheticSketch(options.seed, i, galif.width());
+
+    // the first call builds the filter bank
+    KeyPoints_t keypoints;
+    features.resize(images.size());
+    galif.compute(images[0], keypoints, features[0]);
+
+    ostringstream params;
+    params << "{\"width\":" << galif.width() << ",\"images\":" << images.size() << "}";
+    Result result("galif_compute", params.str());
+    for(uint i = 0; i < images.size(); i++) {
+        Clock_t::time_point start = Clock_t::now();
+        galif.compute(images[i], keypoints, features[i]);
+        result.ms.push_back(millisecondsSince(start));
+        print(i, images.size(), "galif");
+    }
+    results.push_back(result);
+}
+
+// quantize per image at several vocabulary sizes, the images are given by their features
+void benchQuantize(const Options &options, const vector<Features_t> &images, const Features_t &samples, vector<Result> &results)
+{
+    QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > quantizer;
+    const uint vocabularySizes[] = { 250, 1000, 4000 };
+    for(uint v = 0; v < sizeof(vocabularySizes) / sizeof(vocabularySizes[0]); v++) {
+        Vocabularys_t vocabulary = syntheticVocabulary(options.seed, samples, vocabularySizes[v]);
+
+        ostringstream params;
+        params << "{\"vocabulary\":" << vocabulary.size() << ",\"images\":" << images.size() << "}";
+        Result result("quantize", params.str());
+        SparseHist_t hist;
+        for(uint i = 0; i < images.size(); i++) {
+            Clock_t::time_point start = Clock_t::now();
+            quantize(images[i], vocabulary, hist, quantizer);
+            result.ms.push_back(millisecondsSince(start));
+        }
+        results.push_back(result);
+        print(v, sizeof(vocabularySizes) / sizeof(vocabularySizes[0]), "quantize");
+    }
+}
+
+// Kmeans::run per iteration
+void benchKmeans(const Options &options, const Features_t &samples, vector<Result> &results)
+{
+    const uint numOfClusters = std::min<size_t>(1000, samples.size());
+    const uint numOfIterations = 3;
+    typedef Kmeans<Features_t, L2norm_squared<Vec_f32_t> > Cluster;
+    Cluster cluster(samples, numOfClusters, KmeansInitRandom, L2norm_squared<Vec_f32_t>(), options.seed);
+
+    ostringstream params;
+    params << "{\"samples\":" << samples.size() << ",\"dimensions\":" << samples.cols()
+           << ",\"clusters\":" << numOfClusters << ",\"threads\":" << std::thread::hardware_concurrency() << "}";
+    Result result("kmeans_iteration", params.str());
+    for(uint i = 0; i < numOfIterations; i++) {
+        Clock_t::time_point start = Clock_t::now();
+        cluster.run(1, 0);
+        result.ms.push_back(millisecondsSince(start));
+    }
+    results.push_back(result);
+}
+
+// InvertedIndex::createIndex, save, load and query at 10^4 ... maxDocuments documents
+void benchIndex(const Options &options, const string &tempFile, vector<Result> &results)
+{
+    const uint vocabularySize = 1000;
+    const uint numOfFeatures = 300;
+    const uint numOfResults = 50;
+    TF_simple tf;
+    IDF_simple idf;
+
+    for(uint documents = 10000; documents <= options.maxDocuments; documents *= 10) {
+        ostringstream params;
+        params << "{\"documents\":" << documents << ",\"vocabulary\":" << vocabularySize
+               << ",\"features\":" << numOfFeatures << "}";
+
+        InvertedIndex index(vocabularySize);
+        for(uint i = 0; i < documents; i++) {
+            index.addSample(syntheticHistogram(options.seed, i, vocabularySize, numOfFeatures));
+        }
+
+        Result create("index_create", params.str());
+        Clock_t::time_point start = Clock_t::now();
+        index.createIndex(tf, idf);
+        create.ms.push_back(millisecondsSince(start));
+        results.push_back(create);
+
+        Result save("index_save", params.str());
+        start = Clock_t::now();
+        index.save(tempFile);
+        save.ms.push_back(millisecondsSince(start));
+        results.push_back(save);
+
+        Result load("index_load", params.str());
+        InvertedIndex loaded;
+        start = Clock_t::now();
+        loaded.load(tempFile);
+        load.ms.push_back(millisecondsSince(start));
+        results.push_back(load);
+        std::remove(tempFile.c_str());
+
+        // queries are histograms the index has not seen
+        Result query("index_query", params.str());
+        vector<ResultItem_t> items;
+        for(uint q = 0; q < options.numOfQueries; q++) {
+            SparseHist_t hist = syntheticHistogram(options.seed, documents + q, vocabularySize, numOfFeatures);
+            Vec_f32_t sample(vocabularySize, 0);
+            for(size_t t = 0; t < hist.size(); t++) sample[hist[t].first] = hist[t].second;
+
+            start = Clock_t::now();
+            loaded.query(sample, tf, idf, numOfResults, items);
+            query.ms.push_back(millisecondsSince(start));
+        }
+        results.push_back(query);
+        cout << "index " << documents << " documents done." <<endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc % 2 == 0) {
+        usages();
+        exit(1);
+    }
+
+    string outputFile = "bench.json";
+    string benchmarks = "galif,quantize,kmeans,index";
+    string label;
+    Options options;
+    options.numOfImages = 64;
+    options.maxDocuments = 100000;
+    options.numOfQueries = 100;
+    options.seed = DefaultSeed;
+    for(int i = 1; i < argc; i += 2) {
+        if(!strcmp(argv[i], "-o")) outputFile = argv[i+1];
+        else if(!strcmp(argv[i], "-b")) benchmarks = argv[i+1];
+        else if(!strcmp(argv[i], "-n")) options.numOfImages = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-d")) options.maxDocuments = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-q")) options.numOfQueries = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-s")) options.seed = strtoul(argv[i+1], NULL, 10);
+        else if(!strcmp(argv[i], "-l")) label = argv[i+1];
+        else {
+            usages();
+            exit(1);
+        }
+    }
+
+    if(options.numOfImages == 0 || options.numOfQueries == 0) {
+        usages();
+        exit(1);
+    }
+
+    set<string> selected;
+    stringstream list(benchmarks);
+    for(string name; getline(list, name, ',');) selected.insert(name);
+
+    vector<Result> results;
+    const Galif galif;
+
+    // quantize and kmeans work on the features of the sketches
+    vector<Features_t> features;
+    Features_t samples;
+    if(selected.count("galif") || selected.count("quantize") || selected.count("kmeans")) {
+        vector<Result> galifResults;
+        benchGalif(options, galif, galifResults, features);
+        if(selected.count("galif")) results.insert(results.end(), galifResults.begin(), galifResults.end());
+        for(size_t i = 0; i < features.size(); i++) {
+            for(size_t r = 0; r < features[i].size(); r++) samples.push_back(features[i][r]);
+        }
+    }
+    if(selected.count("quantize")) benchQuantize(options, features, samples, results);
+    if(selected.count("kmeans")) benchKmeans(options, samples, results);
+    if(selected.count("index")) benchIndex(options, outputFile + ".index", results);
+
+    ofstream out(outputFile.c_str());
+    out << "{\"label\":\"" << label << "\",\"seed\":" << options.seed << ",\"benchmarks\":[";
+    for(size_t i = 0; i < results.size(); i++) {
+        out << (i > 0 ? ",\n" : "\n");
+        results[i].write(out);
+    }
+    out << "\n]}\n";
+    out.close();
+    cout << "results written to " << outputFile <<endl;
+
+    return 0;
+}
@@ -0,0 +1,262 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <unistd.h>
+using namespace std;
+
+#include "opensse/opensse.h"
+#include "synthetic.h"
+
+using namespace sse;
+
+// Self checks of properties the benchmarks rely on, on synthetic data.
+// Prints one line per check and exits with the number of failed checks.
+
+// ----------------------------------------------------------------
+// every operator new of the process is counted while counting is on,
+// this includes the allocations inside OpenCV (cv::Mat buffers, filter engines)
+static std::atomic<bool> counting(false);
+static std::atomic<size_t> allocations(0);
+static std::atomic<size_t> allocatedBytes(0);
+
+void* operator new(size_t size)
+{
+    if(counting) {
+        allocations++;
+        allocatedBytes += size;
+    }
+    void *p = std::malloc(size > 0 ? size : 1);
+    if(!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+struct AllocationCount
+{
+    size_t allocations;
+    size_t bytes;
+};
+
+template <class Fn>
+AllocationCount countAllocations(Fn fn)
+{
+    allocations = 0;
+    allocatedBytes = 0;
+    counting = true;
+    fn();
+    counting = false;
+    AllocationCount count = { allocations, allocatedBytes };
+    return count;
+}
+// ----------------------------------------------------------------
+
+static bool check(bool ok, const string &name, const string &detail)
+{
+    cout << (ok ? "ok      " : "FAILED  ") << name << ": " << detail <<endl;
+    return ok;
+}
+
+// Galif::compute with a workspace on images of one size: the buffers of the workspace
+// are reused, what is left are the per call scratch buffers of the OpenCV routines.
+// Those neither grow from call to call nor come anywhere near the workspace buffers.
+bool checkWorkspaceReuse(unsigned int seed)
+{
+    const Galif galif;
+    vector<cv::Mat> images(8);
+    for(uint i = 0; i < images.size(); i++) images[i] = syntheticSketch(seed, i, galif.width());
+
+    GalifWorkspace workspace;
+    KeyPoints_t keypoints;
+    Features_t features;
+
+    // the first call allocates the workspace
+    galif.compute(images[0], keypoints, features, workspace);
+    AllocationCount cold = countAllocations([&]() {
+        GalifWorkspace fresh;
+        KeyPoints_t freshKeypoints;
+        Features_t freshFeatures;
+        galif.compute(images[0], freshKeypoints, freshFeatures, fresh);
+    });
+
+    // once every image has been seen, the vectors of the workspace have their largest capacity
+    for(uint i = 1; i < images.size(); i++) galif.compute(images[i], keypoints, features, workspace);
+
+    AllocationCount first = countAllocations([&]() { galif.compute(images[0], keypoints, features, workspace); });
+    bool ok = true;
+    size_t maxBytes = 0;
+    for(uint i = 0; i < images.size(); i++) {
+        AllocationCount warm = countAllocations([&]() { galif.compute(images[i], keypoints, features, workspace); });
+        maxBytes = std::max(maxBytes, warm.bytes);
+        if(i == 0) ok = ok && warm.allocations == first.allocations && warm.bytes == first.bytes;
+    }
+    ok = ok && maxBytes * 10 < cold.bytes;
+
+    ostringstream detail;
+    detail << "fresh workspace " << cold.allocations << " allocations / " << cold.bytes << " bytes, reused "
+           << first.allocations << " allocations / at most " << maxBytes << " bytes";
+    return check(ok, "workspace reuse", detail.str());
+}
+
+// SketchSession after the canvas changed size: every sample gets its words again, so the
+// results are exactly those of a session that starts at the new size, and up to the
+// approximations of IncrementalGalif those of Searcher::search. The two canvases are
+// transposed, they have the same number of samples at other positions.
+bool checkSessionResize(unsigned int seed)
+{
+    char dir[] = "/tmp/opensse_checksXXXXXX";
+    if(!mkdtemp(dir)) return check(false, "session resize", "can not create a temporary directory");
+    const string prefix = string(dir) + "/";
+    const string indexFile = prefix + "index", vocabularyFile = prefix + "vocabulary", fileList = prefix + "filelist";
+
+    // index of synthetic sketches, the filelist only needs the names
+    const Galif galif;
+    const uint numOfImages = 48;
+    vector<Features_t> features(numOfImages);
+    Features_t samples;
+    KeyPoints_t keypoints;
+    for(uint i = 0; i < numOfImages; i++) {
+        galif.compute(syntheticSketch(seed, i, galif.width()), keypoints, features[i]);
+        for(size_t r = 0; r < features[i].size(); r++) samples.push_back(features[i][r]);
+    }
+    Vocabularys_t vocabulary = syntheticVocabulary(seed, samples, 64);
+    write(vocabulary, vocabularyFile);
+
+    QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > quantizer;
+    InvertedIndex index(vocabulary.size());
+    ofstream list(fileList.c_str());
+    for(uint i = 0; i < numOfImages; i++) {
+        SparseHist_t hist;
+        quantize(features[i], vocabulary, hist, quantizer);
+        index.addSample(hist);
+        list << prefix << "sketch" << i << ".png" <<endl;
+    }
+    list.close();
+    TF_simple tf;
+    IDF_simple idf;
+    index.createIndex(tf, idf);
+    index.save(indexFile);
+
+    Searcher searcher(indexFile, vocabularyFile, fileList);
+    Searcher::SnapshotPtr_t snapshot = searcher.snapshot();
+
+    Strokes_t strokes(2);
+    for(int i = 0; i < 20; i++) {
+        strokes[0].push_back(cv::Point2f(60 + 8*i, 80 + 3*i));
+        strokes[1].push_back(cv::Point2f(200 + 2*i, 60 + 9*i));
+    }
+    const cv::Size before(400, 300), after(300, 400);
+    const float penWidth = 3;
+    const uint numOfResults = 10;
+
+    // drawn stroke by stroke, then the canvas turns
+    SketchSession session(searcher.galif());
+    vector<ResultItem_t> results, fresh, expected;
+    session.search(*snapshot, Strokes_t(1, strokes[0]), before, penWidth, numOfResults, results);
+    session.search(*snapshot, strokes, before, penWidth, numOfResults, results);
+    session.search(*snapshot, strokes, after, penWidth, numOfResults, results);
+
+    SketchSession freshSession(searcher.galif());
+    freshSession.search(*snapshot, strokes, after, penWidth, numOfResults, fresh);
+
+    cv::Mat image;
+    rasterizeStrokes(strokes, after, penWidth, galif.width(), image);
+    snapshot->search(image, numOfResults, expected);
+
+    bool ok = results == fresh && results.size() == expected.size();
+    double maxDifference = 0;
+    for(size_t r = 0; ok && r < results.size(); r++) {
+        double difference = std::fabs(results[r].first - expected[r].first) / std::max(1.0f, std::fabs(expected[r].first));
+        maxDifference = std::max(maxDifference, difference);
+    }
+    ok = ok && maxDifference <= 1e-3;
+
+    std::remove(indexFile.c_str());
+    std::remove(vocabularyFile.c_str());
+    std::remove(fileList.c_str());
+    rmdir(dir);
+
+    ostringstream detail;
+    detail << (results == fresh ? "same results as a new session" : "results differ from a new session")
+           << ", largest relative score difference to Searcher::search " << maxDifference;
+    return check(ok, "session resize", detail.str());
+}
+
+// The approximate smoothing modes of Galif against the exact gaussian blur. The histogram
+// bins are the smoothed responses at the tile centres, compared unnormalized, the error is
+// relative to the largest bin of the gaussian features.
+bool checkSmoothingModes(unsigned int seed)
+{
+    const Galif gaussian(256, 4, 4, 0.1, 0.02, 0.3, 0.1, true, "none", "stroke", 625, "gaussian");
+    const Galif recursive(256, 4, 4, 0.1, 0.02, 0.3, 0.1, true, "none", "stroke", 625, "recursive");
+    const Galif boxes(256, 4, 4, 0.1, 0.02, 0.3, 0.1, true, "none", "stroke", 625, "boxes");
+
+    double peak = 0, recursiveError = 0, boxesError = 0;
+    bool sameKeypoints = true;
+    for(uint i = 0; i < 8; i++) {
+        cv::Mat image = syntheticSketch(seed, i, gaussian.width());
+        KeyPoints_t keypoints, recursiveKeypoints, boxesKeypoints;
+        Features_t expected, recursiveFeatures, boxesFeatures;
+        gaussian.compute(image, keypoints, expected);
+        recursive.compute(image, recursiveKeypoints, recursiveFeatures);
+        boxes.compute(image, boxesKeypoints, boxesFeatures);
+        if(recursiveFeatures.size() != expected.size() || boxesFeatures.size() != expected.size()) {
+            sameKeypoints = false;
+            break;
+        }
+
+        const size_t length = expected.size() * gaussian.featureLength();
+        for(size_t j = 0; j < length; j++) {
+            peak = std::max(peak, static_cast<double>(std::fabs(expected.data()[j])));
+            recursiveError = std::max(recursiveError, static_cast<double>(std::fabs(recursiveFeatures.data()[j] - expected.data()[j])));
+            boxesError = std::max(boxesError, static_cast<double>(std::fabs(boxesFeatures.data()[j] - expected.data()[j])));
+        }
+    }
+    if(!sameKeypoints || peak <= 0)
+        return check(false, "smoothing modes", "the modes do not compute the same samples");
+
+    recursiveError /= peak;
+    boxesError /= peak;
+    ostringstream detail;
+    detail << "largest difference to gaussian relative to the peak response, recursive "
+           << recursiveError << " (at most 0.02), boxes " << boxesError << " (at most 0.065)";
+    return check(recursiveError <= 0.02 && boxesError <= 0.065, "smoothing modes", detail.str());
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int seed = argc > 1 ? atoi(argv[1]) : DefaultSeed;
+
+    // OpenCV worker threads would allocate at times of their own
+    cv::setNumThreads(0);
+
+    int failed = 0;
+    failed += !checkWorkspaceReuse(seed);
+    failed += !checkSessionResize(seed);
+    failed += !checkSmoothingModes(seed);
+    return failed;
+}
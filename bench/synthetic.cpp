@@ -0,0 +1,88 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include "synthetic.h"
+
+namespace sse {
+
+// streams of make_rng, the kind of data and the index are mixed into one stream id
+enum { SketchStream = 0, HistogramStream = 1, VocabularyStream = 2 };
+
+static unsigned int stream(unsigned int kind, uint index)
+{
+    return index * 4 + kind;
+}
+
+cv::Mat syntheticSketch(unsigned int seed, uint index, uint width)
+{
+    Rng_t rng = make_rng(seed, stream(SketchStream, index));
+
+    const float canvas = 512;
+    const float penWidth = 2 + 4 * random_uniform(rng);
+    Strokes_t strokes(3 + random_index(rng, 10));
+    for (size_t s = 0; s < strokes.size(); s++) {
+        // random walk with a slowly turning direction
+        cv::Point2f p(canvas * (0.2 + 0.6 * random_uniform(rng)), canvas * (0.2 + 0.6 * random_uniform(rng)));
+        double angle = 2 * M_PI * random_uniform(rng);
+        double curvature = 0.3 * (random_uniform(rng) - 0.5);
+        const uint numOfPoints = 10 + random_index(rng, 40);
+        for (uint i = 0; i < numOfPoints; i++) {
+            strokes[s].push_back(p);
+            angle += curvature + 0.2 * (random_uniform(rng) - 0.5);
+            p.x = std::min(canvas - 1, std::max(0.0f, static_cast<float>(p.x + 8 * std::cos(angle))));
+            p.y = std::min(canvas - 1, std::max(0.0f, static_cast<float>(p.y + 8 * std::sin(angle))));
+        }
+    }
+
+    cv::Mat image;
+    rasterizeStrokes(strokes, cv::Size(canvas, canvas), penWidth, width, image);
+    return image;
+}
+
+SparseHist_t syntheticHistogram(unsigned int seed, uint index, uint vocabularySize, uint numOfFeatures)
+{
+    Rng_t rng = make_rng(seed, stream(HistogramStream, index));
+
+    std::vector<uint> words(numOfFeatures);
+    for (uint i = 0; i < numOfFeatures; i++) {
+        double u = random_uniform(rng);
+        words[i] = std::min(vocabularySize - 1, static_cast<uint>(vocabularySize * u * u * u));
+    }
+    std::sort(words.begin(), words.end());
+
+    SparseHist_t hist;
+    for (uint i = 0; i < words.size(); i++) {
+        if (hist.empty() || hist.back().first != words[i])
+            hist.push_back(Term_t(words[i], 0));
+        hist.back().second++;
+    }
+    return hist;
+}
+
+Vocabularys_t syntheticVocabulary(unsigned int seed, const Features_t &samples, uint numOfWords)
+{
+    assert(samples.size() > 0);
+    Rng_t rng = make_rng(seed, stream(VocabularyStream, numOfWords));
+
+    Vocabularys_t vocabulary(numOfWords);
+    for (uint i = 0; i < numOfWords; i++) {
+        Features_t::ConstRow row = samples[random_index(rng, samples.size())];
+        vocabulary[i].assign(&row[0], &row[0] + samples.cols());
+    }
+    return vocabulary;
+}
+
+} //namespace sse
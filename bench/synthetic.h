@@ -0,0 +1,40 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#ifndef SYNTHETIC_H
+#define SYNTHETIC_H
+
+#include "opensse/opensse.h"
+
+namespace sse {
+
+// Procedurally generated inputs of the benchmarks, the same seed and index
+// always give the same data, so runs on different commits are comparable.
+
+// Sketch of a few smooth random strokes, black on white, CV_8UC1,
+// the longer side is width pixels
+cv::Mat syntheticSketch(unsigned int seed, uint index, uint width);
+
+// Quantized image of numOfFeatures features. Word frequencies follow a
+// power law like those of real vocabularies, low word ids are the common ones
+SparseHist_t syntheticHistogram(unsigned int seed, uint index, uint vocabularySize, uint numOfFeatures);
+
+// numOfWords rows of samples picked at random, as the random kmeans initialization does
+Vocabularys_t syntheticVocabulary(unsigned int seed, const Features_t &samples, uint numOfWords);
+
+} //namespace sse
+
+#endif // SYNTHETIC_H
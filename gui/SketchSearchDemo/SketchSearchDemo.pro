@@ -26,6 +26,8 @@ QT       += core gui \
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
+CONFIG += c++11
+
 TARGET = SketchSearchDemo
 TEMPLATE = app
 
@@ -54,9 +56,11 @@ SOURCES += main.cpp\
     sketcharea.cpp \
     resultphotowidget.cpp \
     sketchsearcher.cpp \
+    asyncsearchengine.cpp \
 
 HEADERS  += mainwindow.h \
     sketcharea.h \
     searchengine.h \
     resultphotowidget.h \
     sketchsearcher.h \
+    asyncsearchengine.h \
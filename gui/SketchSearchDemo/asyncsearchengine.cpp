@@ -0,0 +1,138 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include "asyncsearchengine.h"
+
+#include <iostream>
+
+AsyncSearchEngine::AsyncSearchEngine(SearchEngine *engine, QObject *parent)
+    : QObject(parent)
+    , searchEngine(engine)
+    , hasPending(false)
+    , stopping(false)
+    , generation(0)
+{
+    qRegisterMetaType<QueryResults>("QueryResults");
+
+    worker = std::thread(&AsyncSearchEngine::run, this);
+}
+
+AsyncSearchEngine::~AsyncSearchEngine()
+{
+    {
+        std::lock_guard<std::mutex> locker(mutex);
+        stopping = true;
+    }
+    available.notify_one();
+    worker.join();
+}
+
+void AsyncSearchEngine::query(const std::string &fileName)
+{
+    Request request;
+    request.type = Request::PATH;
+    request.fileName = fileName;
+    submit(request);
+}
+
+void AsyncSearchEngine::query(const cv::Mat &sketch)
+{
+    Request request;
+    request.type = Request::IMAGE;
+    // the caller may reuse its pixels as soon as we return
+    request.sketch = sketch.clone();
+    submit(request);
+}
+
+void AsyncSearchEngine::query(const Strokes &strokes, const cv::Size &canvasSize, float penWidth)
+{
+    Request request;
+    request.type = Request::STROKES;
+    request.strokes = strokes;
+    request.canvasSize = canvasSize;
+    request.penWidth = penWidth;
+    submit(request);
+}
+
+void AsyncSearchEngine::cancel()
+{
+    std::lock_guard<std::mutex> locker(mutex);
+    hasPending = false;
+    generation++;
+}
+
+void AsyncSearchEngine::submit(const Request &request)
+{
+    {
+        std::lock_guard<std::mutex> locker(mutex);
+        pending = request;
+        hasPending = true;
+        generation++;
+    }
+    available.notify_one();
+}
+
+void AsyncSearchEngine::deliver(const QueryResults &results, quint64 queryGeneration)
+{
+    {
+        std::lock_guard<std::mutex> locker(mutex);
+        if(queryGeneration != generation)
+            return;
+    }
+    emit resultsReady(results);
+}
+
+void AsyncSearchEngine::run()
+{
+    for(;;) {
+        Request request;
+        quint64 queryGeneration;
+        {
+            std::unique_lock<std::mutex> locker(mutex);
+            available.wait(locker, [this]() { return hasPending || stopping; });
+            if(stopping)
+                return;
+            request = pending;
+            hasPending = false;
+            queryGeneration = generation;
+        }
+
+        // an exception escaping this thread would terminate the application,
+        // a failed query shows no results instead
+        QueryResults results;
+        try {
+            switch(request.type) {
+            case Request::PATH:
+                searchEngine->query(request.fileName, results);
+                break;
+            case Request::IMAGE:
+                searchEngine->query(request.sketch, results);
+                break;
+            case Request::STROKES:
+                searchEngine->query(request.strokes, request.canvasSize, request.penWidth, results);
+                break;
+            }
+        }
+        catch(const std::exception &e) {
+            std::cerr << "search failed: " << e.what() << std::endl;
+            results.clear();
+        }
+
+        // back on our own thread, where deliver() drops the results if a newer query came in meanwhile
+        QMetaObject::invokeMethod(this, "deliver", Qt::QueuedConnection,
+                                  Q_ARG(QueryResults, results), Q_ARG(quint64, queryGeneration));
+    }
+}
@@ -0,0 +1,90 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#ifndef ASYNCSEARCHENGINE_H
+#define ASYNCSEARCHENGINE_H
+
+#include <QObject>
+#include <QMetaType>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "searchengine.h"
+
+Q_DECLARE_METATYPE(QueryResults)
+
+/**
+ * @brief The AsyncSearchEngine class
+ * Runs the queries of a SearchEngine on a worker thread, so that the UI
+ * thread keeps drawing while a search runs. The latest query wins: a query
+ * replaces the one still waiting, and the results of a query that has been
+ * superseded (or cancelled) by the time it finishes are dropped. Results
+ * arrive through the queued resultsReady signal, on the thread this object
+ * lives in.
+ *
+ * The engine is only used by the worker thread from then on.
+ */
+class AsyncSearchEngine : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AsyncSearchEngine(SearchEngine *engine, QObject *parent = 0);
+    ~AsyncSearchEngine();
+
+    // same inputs as SearchEngine::query, the sketch is copied
+    void query(const std::string &fileName);
+    void query(const cv::Mat &sketch);
+    void query(const Strokes &strokes, const cv::Size &canvasSize, float penWidth);
+
+    // drops the results of all queries made so far
+    void cancel();
+
+signals:
+    void resultsReady(const QueryResults &results);
+
+private slots:
+    void deliver(const QueryResults &results, quint64 generation);
+
+private:
+    struct Request
+    {
+        enum Type { PATH, IMAGE, STROKES } type;
+        std::string fileName;
+        cv::Mat sketch;
+        Strokes strokes;
+        cv::Size canvasSize;
+        float penWidth;
+    };
+
+    void submit(const Request &request);
+    void run();
+
+    SearchEngine *searchEngine;
+
+    std::mutex mutex;
+    std::condition_variable available;
+    Request pending;
+    bool hasPending;
+    bool stopping;
+    // number of the latest query, incremented by every query and cancel
+    quint64 generation;
+
+    std::thread worker;
+};
+
+#endif // ASYNCSEARCHENGINE_H
@@ -31,11 +31,11 @@ MainWindow::MainWindow(QWidget *parent)
 {
     Json config = Json("/tmp/SketchSearchDemo/config.json"); //
     searchEngine = new SketchSearcher(config);
+    asyncSearchEngine = new AsyncSearchEngine(searchEngine, this);
 
     setupMenuBar();
 
     sketchArea = new SketchArea;
-    sketchArea->setAutoSaveSketch(true);
     triMeshView = new TriMeshView;
     //triMeshView->readMesh("./data/1_01.obj");
     QSplitter *leftSplitter = new QSplitter(Qt::Vertical);
@@ -65,7 +65,9 @@ MainWindow::MainWindow(QWidget *parent)
     this->setMinimumSize(800, 600);
 
     //auto search
-    connect(sketchArea, SIGNAL(newSketchDone(QString)), this, SLOT(search(QString)));
+    connect(sketchArea, SIGNAL(newSketchDone()), this, SLOT(search()));
+
+    connect(asyncSearchEngine, SIGNAL(resultsReady(QueryResults)), this, SLOT(showResults(QueryResults)));
 
     connect(sketchArea, SIGNAL(clearSketchDone()), this, SLOT(clearResults()));
     connect(resultPhotoWidget, SIGNAL(itemClicked(QTableWidgetItem*)), this, SLOT(showLineDrawing(QTableWidgetItem*)));
@@ -79,6 +81,9 @@ void MainWindow::setupMenuBar()
     QAction *openAction = fileMenu->addAction(tr("&Open"));
     connect(openAction, SIGNAL(triggered()), this, SLOT(openFile()));
 
+    QAction *reloadAction = fileMenu->addAction(tr("&Reload index"));
+    connect(reloadAction, SIGNAL(triggered()), this, SLOT(reloadIndex()));
+
     QAction *queryAction = menuBar()->addAction(tr("&Query"));
     connect(queryAction, SIGNAL(triggered()), this, SLOT(query()));
 }
@@ -94,22 +99,47 @@ void MainWindow::openFile()
     }
 }
 
+void MainWindow::reloadIndex()
+{
+    searchEngine->reload();
+}
+
 void MainWindow::query()
 {
-    QueryResults results;
-    searchEngine->query(sketchArea->sketchPath().toStdString(), results);
-    resultPhotoWidget->updateResults(results);
+    search();
 }
 
-void MainWindow::search(const QString &fileName)
+void MainWindow::search()
 {
-    QueryResults results;
-    searchEngine->query(fileName.toStdString(), results);
-    resultPhotoWidget->updateResults(results);
+    // runs on the worker of asyncSearchEngine, showResults() receives the results
+    if(sketchArea->hasOnlyStrokes()) {
+        // rasterized by the search engine, no need to scale the canvas down
+        const QList<QPolygonF> &polygons = sketchArea->sketchStrokes();
+        Strokes strokes(polygons.size());
+        for(int i = 0; i < polygons.size(); i++) {
+            for(int j = 0; j < polygons[i].size(); j++)
+                strokes[i].push_back(cv::Point2f(polygons[i][j].x(), polygons[i][j].y()));
+        }
+        const QImage &canvas = sketchArea->sketchImage();
+        asyncSearchEngine->query(strokes, cv::Size(canvas.width(), canvas.height()), sketchArea->penWidth());
+    }
+    else {
+        QImage canvas = sketchArea->sketchImage().convertToFormat(QImage::Format_RGB888);
+        cv::Mat sketch(canvas.height(), canvas.width(), CV_8UC3, canvas.bits(), canvas.bytesPerLine());
+        asyncSearchEngine->query(sketch);
+    }
+}
+
+void MainWindow::showResults(const QueryResults &results)
+{
+    QueryResults res = results;
+    resultPhotoWidget->updateResults(res);
 }
 
 void MainWindow::clearResults()
 {
+    asyncSearchEngine->cancel();
+
     QueryResults res;
     resultPhotoWidget->updateResults(res);
     triMeshView->clearMesh();
@@ -137,5 +167,7 @@ void MainWindow::showLineDrawing(QTableWidgetItem *item)
 
 MainWindow::~MainWindow()
 {
-
+    // stop the worker before the engine it uses
+    delete asyncSearchEngine;
+    delete searchEngine;
 }
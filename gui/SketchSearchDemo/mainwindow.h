@@ -20,7 +20,7 @@
 #include <QMainWindow>
 
 #include "sketcharea.h"
-#include "searchengine.h"
+#include "asyncsearchengine.h"
 #include "resultphotowidget.h"
 #include "trimeshview.h"
 
@@ -33,10 +33,12 @@ public:
     ~MainWindow();
 private slots:
     void openFile();
+    void reloadIndex();
     void query();
-    void search(const QString &fileName);
+    void search();
     void showLineDrawing(QTableWidgetItem *item);
     void clearResults();
+    void showResults(const QueryResults &results);
 private:
     void setupMenuBar();
 private:
@@ -44,6 +46,7 @@ private:
     TriMeshView *triMeshView;
     ResultPhotoWidget *resultPhotoWidget;
     SearchEngine *searchEngine;
+    AsyncSearchEngine *asyncSearchEngine;
 };
 
 #endif // MAINWINDOW_H
@@ -20,6 +20,8 @@
 #include <string>
 #include <vector>
 
+#include <opencv2/core/core.hpp>
+
 typedef unsigned int uint;
 
 struct QueryResult
@@ -36,14 +38,26 @@ struct QueryResult
 
 typedef std::vector<QueryResult> QueryResults;
 
+// polylines in canvas coordinates, one per stroke
+typedef std::vector<std::vector<cv::Point2f> > Strokes;
+
 /**
  * @brief The SearchEngine class
- * Search engine interface
+ * Search engine interface, the queries block until the results are there,
+ * see AsyncSearchEngine to run them off the UI thread
  */
 class SearchEngine
 {
 public:
+    virtual ~SearchEngine() {}
+
     virtual void query(const std::string &fileName, QueryResults& results) = 0;
+    // sketch image in memory, 3 channels
+    virtual void query(const cv::Mat &sketch, QueryResults& results) = 0;
+    // strokes drawn on a canvas of canvasSize with a pen of penWidth pixels
+    virtual void query(const Strokes &strokes, const cv::Size &canvasSize, float penWidth, QueryResults& results) = 0;
+    // loads the index again in the background, queries go on meanwhile
+    virtual void reload() = 0;
 };
 
 #endif // SEARCHENGINE_H
@@ -44,6 +44,8 @@ SketchArea::SketchArea(QWidget *parent) :
 
     autoSaveSketch = false;
     saveSketchFileName = "/tmp/temp.jpg";
+
+    onlyStrokes = true;
 }
 
 bool SketchArea::openImage(const QString &fileName)
@@ -54,7 +56,8 @@ bool SketchArea::openImage(const QString &fileName)
 
     clearImage();
 
-    loadedImage.save(saveSketchFileName, "JPG");
+    if(autoSaveSketch)
+        loadedImage.save(saveSketchFileName, "JPG");
 
     QSize newSize;
     if(loadedImage.size().width() > size().width() || loadedImage.size().height() > size().height())
@@ -70,8 +73,9 @@ bool SketchArea::openImage(const QString &fileName)
     image = loadedImage.convertToFormat(QImage::Format_ARGB32);
 
     modified = false;
+    onlyStrokes = false;
 
-    emit newSketchDone(fileName);
+    emit newSketchDone();
     update();
     return true;
 }
@@ -118,6 +122,8 @@ void SketchArea::setAutoSaveSketch(bool save, const QString &fileName)
 void SketchArea::clearImage()
 {
     image.fill(qRgb(255, 255, 255));
+    strokes.clear();
+    onlyStrokes = true;
     modified = true;
     update();
     emit clearSketchDone();
@@ -154,6 +160,8 @@ void SketchArea::mousePressEvent(QMouseEvent *event)
     if (event->button() == Qt::LeftButton) {
         lastPoint = event->pos();
         scribbling = true;
+        if(!erasing)
+            strokes.append(QPolygonF() << lastPoint);
     }
     else if(event->button() == Qt::RightButton) {
         lastPoint = event->pos();
@@ -190,7 +198,7 @@ void SketchArea::mouseReleaseEvent(QMouseEvent *event)
         saveImage(saveSketchFileName, "JPG");
 
     if(event->button() == Qt::LeftButton || event->button() == Qt::RightButton)
-        emit newSketchDone(saveSketchFileName);
+        emit newSketchDone();
 }
 
 void SketchArea::paintEvent(QPaintEvent *event)
@@ -239,6 +247,11 @@ void SketchArea::drawLineTo(const QPoint &endPoint)
     if(endPoint.x() < rect().width() && endPoint.y() < rect().height())
         painter.drawLine(lastPoint, endPoint);
 
+    if(erasing)
+        onlyStrokes = false;
+    else if(!strokes.isEmpty())
+        strokes.last() << endPoint;
+
     modified = true;
 
     int rad = ((erasing == true ? myEraserWidth : myPenWidth) / 2) + 2;
@@ -25,11 +25,15 @@
 #include <QWidget>
 #include <QMouseEvent>
 #include <QKeyEvent>
+#include <QList>
+#include <QPolygonF>
 
 /**
  * @brief The SketchArea class
  * draw sketch panel
  * when mouse release, emit newSketchDone signal
+ * the sketch is available in memory as image and, unless it was erased or
+ * loaded from a file, as strokes
  * using setAutoSaveSketch save sketch image.
  */
 class SketchArea : public QWidget
@@ -52,13 +56,17 @@ public:
     void setAutoSaveSketch(bool save, const QString &fileName = "/tmp/temp.jpg");
 
     QString sketchPath() const { return saveSketchFileName; }
+    const QImage& sketchImage() const { return image; }
+    // the strokes drawn since the last clear, only complete if hasOnlyStrokes()
+    const QList<QPolygonF>& sketchStrokes() const { return strokes; }
+    bool hasOnlyStrokes() const { return onlyStrokes; }
     bool isModified() const { return modified; }
     QColor penColor() const { return myPenColor; }
     int penWidth() const { return myPenWidth; }
     QColor eraserColor() const { return myEraserColor; }
     int eraserWidth() const { return myEraserWidth; }
 signals:
-    void newSketchDone(const QString &fileName);
+    void newSketchDone();
     void clearSketchDone();
 public slots:
     void clearImage();
@@ -91,6 +99,9 @@ private:
 
     QImage image;
     QPoint lastPoint;
+
+    QList<QPolygonF> strokes;
+    bool onlyStrokes;
 };
 
 #endif // SKETCHAREA_H
@@ -23,60 +23,68 @@ SketchSearcher::SketchSearcher(Json &config)
     , _fileList(config.getValue("searcher$filelist", "/tmp/SketchSearchDemo/data/model_filelist"))
     , _numOfResults(convert<uint>(config.getValue("searcher$results_num", "25"), UINT))
     , _numOfViews(convert<uint>(config.getValue("searcher$views_num", "1"), UINT))
+    , searcher(_indexFile, _vocabularyFile, _fileList, _numOfViews)
+    , session(searcher.galif())
 {
-    index = new InvertedIndex();
-    index->load(_indexFile);
+    uint cacheSize = convert<uint>(config.getValue("searcher$cache_size", "0"), UINT);
+    uint cacheTtl = convert<uint>(config.getValue("searcher$cache_ttl", "0"), UINT);
+    if(cacheSize > 0)
+        searcher.enableCache(cacheSize, std::chrono::seconds(cacheTtl));
 
-    read(_vocabularyFile, vocabulary);
-
-    galif = new Galif();
-
-    quantizer = QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> >();
-
-    files = new FileList;
-    files->load(_fileList);
+    // soft quantization of the queries, only if the index was built with it as well
+    uint softNearest = convert<uint>(config.getValue("searcher$soft_nearest", "1"), UINT);
+    float softSigma = convert<float>(config.getValue("searcher$soft_sigma", "0.2"), FLOAT);
+    if(softNearest > 1 && softSigma > 0)
+        searcher.enableSoftQuantization(softNearest, softSigma);
 }
 
 SketchSearcher::~SketchSearcher()
 {
-    delete index;
-    delete galif;
-    delete files;
 }
 
 void SketchSearcher::query(const std::string &fileName, QueryResults &results)
 {
-    //extract features
-    KeyPoints_t keypoints;
-    Features_t features;
-    cv::Mat image = cv::imread(fileName.c_str());
-
-    galif->compute(image, keypoints, features);
-
-    //quantize
-    Vec_f32_t query;
-    quantize(features, vocabulary, query, quantizer);
+    Searcher::SnapshotPtr_t snapshot = searcher.snapshot();
+    std::vector<ResultItem_t> items;
+    try {
+        snapshot->search(fileName, _numOfResults, items);
+    }
+    catch(const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+    }
+    toQueryResults(*snapshot, items, results);
+}
 
-    TF_simple tf;
-    IDF_simple idf;
+void SketchSearcher::query(const cv::Mat &sketch, QueryResults &results)
+{
+    Searcher::SnapshotPtr_t snapshot = searcher.snapshot();
+    std::vector<ResultItem_t> items;
+    session.search(*snapshot, sketch, _numOfResults, items);
+    toQueryResults(*snapshot, items, results);
+}
 
-    std::vector<ResultItem_t> _results;
-    //std::cout<< "query: " <<_results.size()<<std::endl;
+void SketchSearcher::query(const Strokes &strokes, const cv::Size &canvasSize, float penWidth, QueryResults &results)
+{
+    Searcher::SnapshotPtr_t snapshot = searcher.snapshot();
+    std::vector<ResultItem_t> items;
+    session.search(*snapshot, strokes, canvasSize, penWidth, _numOfResults, items);
+    toQueryResults(*snapshot, items, results);
+}
 
-    if(_numOfViews == 1)
-    {
-        index->query(query, tf, idf, _numOfResults, _results);
-    }
-    else {
-        index->query(query, tf, idf, _numOfResults, _numOfViews, _results);
-    }
+void SketchSearcher::reload()
+{
+    searcher.reloadInBackground();
+}
 
-    results.resize(_results.size());
+void SketchSearcher::toQueryResults(const Searcher::Snapshot &snapshot, const std::vector<ResultItem_t> &items,
+                                    QueryResults &results) const
+{
+    results.resize(items.size());
 
-    for(uint i = 0; i < _results.size(); i++) {
+    for(uint i = 0; i < items.size(); i++) {
 
-        results[i].ratio = _results[i].first;
-        results[i].imageIndex = _results[i].second;
-        results[i].imageName = files->getFilename(_results[i].second);
+        results[i].ratio = items[i].first;
+        results[i].imageIndex = items[i].second;
+        results[i].imageName = snapshot.files().getFilename(items[i].second);
     }
 }
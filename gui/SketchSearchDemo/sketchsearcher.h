@@ -28,14 +28,13 @@ public:
     virtual ~SketchSearcher();
 
     void query(const std::string &fileName, QueryResults &results);
+    void query(const cv::Mat &sketch, QueryResults &results);
+    void query(const Strokes &strokes, const cv::Size &canvasSize, float penWidth, QueryResults &results);
+    void reload();
 
 private:
-    sse::InvertedIndex *index;
-    sse::Galif *galif;
-    sse::FileList *files;
-
-    sse::Vocabularys_t vocabulary;
-    sse::QuantizerHard<sse::Vec_f32_t, sse::L2norm_squared<sse::Vec_f32_t> > quantizer;
+    void toQueryResults(const sse::Searcher::Snapshot &snapshot, const std::vector<sse::ResultItem_t> &items,
+                        QueryResults &results) const;
 
     const std::string _indexFile;
     const std::string _vocabularyFile;
@@ -43,6 +42,10 @@ private:
     const std::string _fileList;
     const unsigned int _numOfResults;
     const unsigned int _numOfViews;
+
+    sse::Searcher searcher;
+    // the sketch being drawn, only recomputed where it changed
+    sse::SketchSession session;
 };
 
 #endif // SKETCHSEARCHER_H
@@ -3,13 +3,22 @@
 
 #include "sse/common/distance.h"
 #include "sse/common/types.h"
+#include "sse/common/random.h"
+#include "sse/common/matrix.h"
+#include "sse/common/string_view.h"
+#include "sse/common/trace.h"
 #include "sse/features/galif.h"
 #include "sse/index/invertedindex.h"
 #include "sse/io/filelist.h"
+#include "sse/io/dataset_reader.h"
 #include "sse/io/reader_writer.h"
 #include "sse/io/json_parser.h"
 #include "sse/quantize/quantizer.h"
+#include "sse/search/searcher.h"
+#include "sse/search/querycache.h"
+#include "sse/search/session.h"
 #include "sse/vocabulary/kmeans_init.h"
 #include "sse/vocabulary/kmeans.h"
+#include "sse/vocabulary/sample_store.h"
 
 #endif
@@ -24,6 +24,11 @@ LIBS += -L/usr/local/lib/ \
             -lopencv_core -lopencv_imgproc -lopencv_imgcodecs -lopencv_highgui -lopencv_features2d -lopencv_ml
 }
 
+# qmake CONFIG+=sse_trace records per stage latency histograms, see sse/common/trace.h
+sse_trace {
+DEFINES += SSE_TRACE
+}
+
 macx: {
 #for commind line
 CONFIG -= app_bundle
@@ -35,25 +40,42 @@ HEADERS += \
     $$PWD/sse/common/types.h \
     $$PWD/sse/features/feature.h \
     $$PWD/sse/features/galif.h \
+    $$PWD/sse/features/gabor.h \
     $$PWD/sse/features/detector.h \
     $$PWD/sse/features/generator.h \
     $$PWD/sse/features/util.h \
     $$PWD/sse/io/filelist.h \
+    $$PWD/sse/io/dataset_reader.h \
     $$PWD/sse/io/reader_writer.h \
     $$PWD/sse/common/distance.h \
+    $$PWD/sse/common/random.h \
+    $$PWD/sse/common/matrix.h \
+    $$PWD/sse/common/string_view.h \
+    $$PWD/sse/common/trace.h \
     $$PWD/sse/vocabulary/kmeans.h \
     $$PWD/sse/vocabulary/kmeans_init.h \
+    $$PWD/sse/vocabulary/sample_store.h \
     $$PWD/sse/quantize/quantizer.h \
     $$PWD/sse/index/invertedindex.h \
+    $$PWD/sse/search/searcher.h \
+    $$PWD/sse/search/querycache.h \
+    $$PWD/sse/search/session.h \
     $$PWD/sse/index/tfidf.h
 
 SOURCES += \
+    $$PWD/sse/common/trace.cpp \
     $$PWD/sse/features/galif.cpp \
+    $$PWD/sse/features/gabor.cpp \
     $$PWD/sse/features/detector.cpp \
     $$PWD/sse/features/generator.cpp \
     $$PWD/sse/features/util.cpp \
     $$PWD/sse/io/filelist.cpp \
+    $$PWD/sse/io/dataset_reader.cpp \
     $$PWD/sse/io/reader_writer.cpp \
     $$PWD/sse/quantize/quantizer.cpp \
+    $$PWD/sse/vocabulary/sample_store.cpp \
     $$PWD/sse/index/invertedindex.cpp \
+    $$PWD/sse/search/searcher.cpp \
+    $$PWD/sse/search/querycache.cpp \
+    $$PWD/sse/search/session.cpp \
     $$PWD/sse/index/tfidf.cpp
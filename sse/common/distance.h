@@ -30,6 +30,9 @@ namespace sse {
 // describe the distance between two descriptors and thus smaller
 // distances denote more similar objects. The dotproduct itself
 // e.g. is NOT a distance measure, it is a similarity measure
+//
+// T only defines the stl typedefs, operator() accepts any two
+// sequences of the same length, e.g. a Vec_f32_t and a matrix row
 // ----------------------------------------------------------------
 
 //L1 norm
@@ -42,10 +45,12 @@ struct L1norm
     typedef R result_type;
 
     // L1 distance between a and b.
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         R s = 0;
-        for (typename T::const_iterator ai = a.begin(), bi = b.begin(); ai != a.end(); ++ai, ++bi)
+        typename B::const_iterator bi = b.begin();
+        for (typename A::const_iterator ai = a.begin(); ai != a.end(); ++ai, ++bi)
         {
             R d = static_cast<R>(*ai) - static_cast<R>(*bi);
             s += std::abs(d);
@@ -68,10 +73,12 @@ struct L2norm_squared
     typedef R result_type;
 
     // Squared L2 distance between a and b.
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         R s = 0;
-        for (typename T::const_iterator ai = a.begin(), bi = b.begin(); ai != a.end(); ++ai, ++bi)
+        typename B::const_iterator bi = b.begin();
+        for (typename A::const_iterator ai = a.begin(); ai != a.end(); ++ai, ++bi)
         {
             R d = static_cast<R>(*ai) - static_cast<R>(*bi);
             s += d*d;
@@ -94,7 +101,8 @@ struct L2norm
     L2norm_squared<T,R> n;
 
     // L2 (Euclidean) distance between a and b.
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         return std::sqrt(n(a,b));
     }
@@ -116,10 +124,12 @@ struct One_minus_dot
 
     // Computes 1 - <a,b>. As we assume that both a and b have unit length, the
     // result is guaranteed to lie in [0,2]
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         R s = 0;
-        for (typename T::const_iterator ai = a.begin(), bi = b.begin(); ai != a.end(); ++ai, ++bi)
+        typename B::const_iterator bi = b.begin();
+        for (typename A::const_iterator ai = a.begin(); ai != a.end(); ++ai, ++bi)
         {
             s += static_cast<R>(*ai) * static_cast<R>(*bi);
         }
@@ -136,10 +146,12 @@ struct Jsd
     typedef T second_argument_type;
     typedef R result_type;
 
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         R s = 0;
-        for (typename T::const_iterator ai = a.begin(), bi = b.begin(); ai != a.end(); ++ai, ++bi)
+        typename B::const_iterator bi = b.begin();
+        for (typename A::const_iterator ai = a.begin(); ai != a.end(); ++ai, ++bi)
         {
             R v0 = *ai;
             R v1 = *bi;
@@ -168,10 +180,12 @@ struct Chi2
     typedef T second_argument_type;
     typedef R result_type;
 
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         R s = 0;
-        for (typename T::const_iterator ai = a.begin(), bi = b.begin(); ai != a.end(); ++ai, ++bi)
+        typename B::const_iterator bi = b.begin();
+        for (typename A::const_iterator ai = a.begin(); ai != a.end(); ++ai, ++bi)
         {
             R v0 = *ai;
             R v1 = *bi;
@@ -200,7 +214,8 @@ struct Dist_frobenius
     typedef T second_argument_type;
     typedef R result_type;
 
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         assert(a.size() % 3 == 0);
         assert(a.size() == b.size());
@@ -257,7 +272,8 @@ struct Dist_df
      * @param b
      * @return Computes <a,dt(b)> + <b,dt(a)>, result range is [0,inf] where 0 means that a and b are equal
      */
-    R operator() (const T& a, const T& b) const
+    template <class A, class B>
+    R operator() (const A& a, const B& b) const
     {
         assert(a.size() % 2 == 0);
         assert(a.size() == b.size());
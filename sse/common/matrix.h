@@ -0,0 +1,210 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <algorithm>
+#include <iterator>
+#include <assert.h>
+
+namespace sse {
+
+/**
+ * @brief Allocator returning memory aligned to Alignment bytes
+ * (32 bytes = one AVX register), so that rows can be loaded with aligned SIMD loads.
+ */
+template <class T, std::size_t Alignment = 32>
+struct AlignedAllocator
+{
+    typedef T value_type;
+
+    template <class U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+    AlignedAllocator() {}
+    template <class U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+    T* allocate(std::size_t n)
+    {
+        // over-allocate and keep the offset to the real block right in front of the aligned one
+        void *raw = ::operator new(n * sizeof(T) + Alignment + sizeof(void*));
+        std::uintptr_t start = reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*);
+        std::uintptr_t aligned = (start + Alignment - 1) & ~(static_cast<std::uintptr_t>(Alignment) - 1);
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    void deallocate(T *p, std::size_t)
+    {
+        ::operator delete(reinterpret_cast<void**>(p)[-1]);
+    }
+
+    template <class U> bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+    template <class U> bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+/**
+ * @brief View of one row of a Matrix, behaves like a fixed size vector
+ */
+template <class P>
+class RowView
+{
+public:
+    typedef P iterator;
+    typedef P const_iterator;
+
+    RowView(P data, std::size_t size) : _data(data), _size(size) {}
+
+    std::size_t size() const { return _size; }
+    P begin() const { return _data; }
+    P end() const { return _data + _size; }
+    P data() const { return _data; }
+    typename std::iterator_traits<P>::reference operator[](std::size_t i) const { return _data[i]; }
+
+    // adapter for code that still wants a vector
+    template <class T>
+    operator std::vector<T>() const { return std::vector<T>(begin(), end()); }
+
+private:
+    P _data;
+    std::size_t _size;
+};
+
+/**
+ * @brief Dense row major matrix, one sample (keypoint, feature, ...) per row
+ *
+ * All rows live in one aligned block, unlike a vector<vector<T> > where every
+ * row is its own heap allocation. clear() keeps the memory, so a Matrix that is
+ * reused from image to image stops allocating after the first one.
+ *
+ * Rows are accessed with operator[] like in a vector of vectors, with the
+ * difference that they are views into the matrix.
+ */
+template <class T>
+class Matrix
+{
+public:
+    typedef T element_type;
+    // a row copied out of the matrix
+    typedef std::vector<T> value_type;
+    typedef RowView<T*> Row;
+    typedef RowView<const T*> ConstRow;
+
+    Matrix() : _rows(0), _cols(0) {}
+    Matrix(std::size_t rows, std::size_t cols, const T &value = T())
+        : _rows(rows), _cols(cols), _data(rows * cols, value) {}
+
+    // adapter from the old vector<vector<T> > representation, all rows must have the same size
+    explicit Matrix(const std::vector<std::vector<T> > &rows)
+        : _rows(0), _cols(rows.empty() ? 0 : rows[0].size())
+    {
+        reserve(rows.size());
+        for (std::size_t i = 0; i < rows.size(); i++) push_back(rows[i]);
+    }
+
+    // adapter to the old vector<vector<T> > representation
+    std::vector<std::vector<T> > toVectors() const
+    {
+        std::vector<std::vector<T> > rows(_rows);
+        for (std::size_t i = 0; i < _rows; i++) rows[i].assign(row(i), row(i) + _cols);
+        return rows;
+    }
+
+    // Resizes to rows x cols, the content is undefined afterwards
+    void create(std::size_t rows, std::size_t cols)
+    {
+        _rows = rows;
+        _cols = cols;
+        _data.resize(rows * cols);
+    }
+
+    void reserve(std::size_t rows) { _data.reserve(rows * _cols); }
+
+    // Removes all rows but keeps the number of columns and the memory
+    void clear() { _rows = 0; _data.clear(); }
+
+    // Keeps the first rows, new rows are filled with value
+    void resize(std::size_t rows, const T &value = T())
+    {
+        _data.resize(rows * _cols, value);
+        _rows = rows;
+    }
+
+    void push_back(const T *row)
+    {
+        assert(_cols > 0);
+        _data.insert(_data.end(), row, row + _cols);
+        _rows++;
+    }
+
+    void push_back(const std::vector<T> &row)
+    {
+        if (_rows == 0) _cols = row.size();
+        assert(row.size() == _cols);
+        push_back(row.data());
+    }
+
+    template <class P>
+    void push_back(const RowView<P> &row)
+    {
+        if (_rows == 0) _cols = row.size();
+        assert(row.size() == _cols);
+        push_back(&row[0]);
+    }
+
+    // appends a row filled with value and returns it
+    T* append(const T &value = T())
+    {
+        assert(_cols > 0);
+        _data.resize(_data.size() + _cols, value);
+        return row(_rows++);
+    }
+
+    std::size_t size() const { return _rows; }
+    std::size_t rows() const { return _rows; }
+    std::size_t cols() const { return _cols; }
+    bool empty() const { return _rows == 0; }
+
+    T* row(std::size_t i) { assert(i < _rows); return &_data[i * _cols]; }
+    const T* row(std::size_t i) const { assert(i < _rows); return &_data[i * _cols]; }
+    Row operator[](std::size_t i) { return Row(row(i), _cols); }
+    ConstRow operator[](std::size_t i) const { return ConstRow(row(i), _cols); }
+
+    void swap(Matrix &other)
+    {
+        std::swap(_rows, other._rows);
+        std::swap(_cols, other._cols);
+        _data.swap(other._data);
+    }
+
+    T* data() { return _data.data(); }
+    const T* data() const { return _data.data(); }
+
+private:
+    std::size_t _rows;
+    std::size_t _cols;
+    std::vector<T, AlignedAllocator<T> > _data;
+};
+
+typedef Matrix<float> Matrix_f32_t;
+
+} //namespace sse
+
+#endif // MATRIX_H
@@ -0,0 +1,89 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <random>
+#include <iterator>
+#include <algorithm>
+#include <assert.h>
+
+namespace sse {
+
+// ----------------------------------------------------------------
+// Note: everything that needs random numbers (vocabulary training,
+// filelist sampling, ...) takes an explicit seed and draws from an
+// Rng_t built here. The standard fixes the output of std::mt19937
+// and std::seed_seq, but NOT that of std::uniform_*_distribution or
+// std::shuffle, so we only ever use raw engine output below. That
+// keeps results bit-identical across compilers and standard libraries.
+// ----------------------------------------------------------------
+
+typedef std::mt19937 Rng_t;
+
+const unsigned int DefaultSeed = Rng_t::default_seed;
+
+/**
+ * @brief Creates a generator for the given seed
+ *
+ * Threads working on the same task should each use their own
+ * stream (e.g. the thread or chunk index). Different streams of one seed
+ * are independent, and the same (seed, stream) pair always gives the same
+ * sequence, no matter how the work is scheduled.
+ */
+inline Rng_t make_rng(unsigned int seed, unsigned int stream = 0)
+{
+    std::seed_seq seq = { seed, stream };
+    return Rng_t(seq);
+}
+
+// Uniform integer in [0, n), n must be > 0
+inline std::size_t random_index(Rng_t &rng, std::size_t n)
+{
+    assert(n > 0);
+    const unsigned long long range = static_cast<unsigned long long>(Rng_t::max()) + 1;
+    assert(n <= range);
+
+    // reject the incomplete last bucket, so that every index is equally likely
+    const unsigned long long limit = range - range % n;
+    unsigned long long r;
+    do {
+        r = rng();
+    } while (r >= limit);
+    return static_cast<std::size_t>(r % n);
+}
+
+// Uniform real number in [0, 1)
+inline double random_uniform(Rng_t &rng)
+{
+    return rng() * (1.0 / (static_cast<double>(Rng_t::max()) + 1.0));
+}
+
+// Fisher-Yates shuffle
+template <class RandomIt>
+void fisher_yates_shuffle(RandomIt first, RandomIt last, Rng_t &rng)
+{
+    typename std::iterator_traits<RandomIt>::difference_type n = last - first;
+    for (; n > 1; n--) {
+        std::size_t k = random_index(rng, n);
+        std::iter_swap(first + (n - 1), first + k);
+    }
+}
+
+} //namespace sse
+
+#endif // RANDOM_H
@@ -0,0 +1,64 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#ifndef STRING_VIEW_H
+#define STRING_VIEW_H
+
+#include <string>
+#include <cstring>
+#include <ostream>
+
+namespace sse {
+
+/**
+ * @brief Read only reference to characters owned by someone else
+ *
+ * A small stand-in for C++17's std::string_view. It does not copy anything,
+ * the referenced characters must outlive it.
+ */
+class StringView
+{
+public:
+    StringView() : _data(""), _size(0) {}
+    StringView(const char *data, std::size_t size) : _data(data), _size(size) {}
+    StringView(const char *data) : _data(data), _size(std::strlen(data)) {}
+    StringView(const std::string &s) : _data(s.data()), _size(s.size()) {}
+
+    const char* data() const { return _data; }
+    std::size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    char operator[](std::size_t i) const { return _data[i]; }
+    const char* begin() const { return _data; }
+    const char* end() const { return _data + _size; }
+
+    std::string str() const { return std::string(_data, _size); }
+
+    bool operator==(const StringView &s) const { return _size == s._size && std::memcmp(_data, s._data, _size) == 0; }
+    bool operator!=(const StringView &s) const { return !(*this == s); }
+
+private:
+    const char *_data;
+    std::size_t _size;
+};
+
+inline std::ostream& operator<<(std::ostream &out, const StringView &s)
+{
+    return out.write(s.data(), s.size());
+}
+
+} //namespace sse
+
+#endif // STRING_VIEW_H
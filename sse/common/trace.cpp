@@ -0,0 +1,171 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include "trace.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace sse {
+
+static const char *stageNames[NumOfTraceStages] = {
+    "decode", "galif", "scale", "detect", "filter", "smooth", "histogram",
+    "quantize", "score", "topk", "create_index", "search"
+};
+
+static const char *counterNames[NumOfTraceCounters] = {
+    "features", "postings"
+};
+
+static LatencyHistogram stages[NumOfTraceStages];
+static std::atomic<uint64_t> counters[NumOfTraceCounters];
+
+std::size_t LatencyHistogram::bucket(uint64_t ns)
+{
+    if (ns < SubBuckets)
+        return ns;
+
+    int msb = 63 - __builtin_clzll(ns);
+    int shift = msb - SubBits;
+    std::size_t b = (shift + 1) * SubBuckets + static_cast<std::size_t>((ns >> shift) - SubBuckets);
+    return std::min<std::size_t>(b, NumOfBuckets - 1);
+}
+
+uint64_t LatencyHistogram::lowerBound(std::size_t bucket)
+{
+    if (bucket < SubBuckets)
+        return bucket;
+
+    int shift = bucket / SubBuckets - 1;
+    return static_cast<uint64_t>(SubBuckets + bucket % SubBuckets) << shift;
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+    _buckets[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _sum.fetch_add(ns, std::memory_order_relaxed);
+
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while (ns > max && !_max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < NumOfBuckets; i++) _buckets[i].store(0, std::memory_order_relaxed);
+    _count.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const
+{
+    uint64_t n = count();
+    return n > 0 ? static_cast<double>(_sum.load(std::memory_order_relaxed)) / n : 0;
+}
+
+uint64_t LatencyHistogram::quantile(double q) const
+{
+    uint64_t n = count();
+    if (n == 0)
+        return 0;
+
+    // the bucket holding the value of rank ceil(q * n), reported by its midpoint
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * n + 0.5));
+    uint64_t seen = 0;
+    for (int b = 0; b < NumOfBuckets; b++) {
+        seen += _buckets[b].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t lower = lowerBound(b);
+            uint64_t upper = b + 1 < NumOfBuckets ? lowerBound(b + 1) : lower + 1;
+            return std::min(max(), lower + (upper - lower) / 2);
+        }
+    }
+    return max();
+}
+
+const char* traceStageName(TraceStage stage)
+{
+    return stageNames[stage];
+}
+
+const char* traceCounterName(TraceCounter counter)
+{
+    return counterNames[counter];
+}
+
+bool traceEnabled()
+{
+#ifdef SSE_TRACE
+    return true;
+#else
+    return false;
+#endif
+}
+
+void traceRecord(TraceStage stage, uint64_t ns)
+{
+    stages[stage].record(ns);
+}
+
+void traceCount(TraceCounter counter, uint64_t n)
+{
+    counters[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+void writeTrace(std::ostream &out)
+{
+    if (!traceEnabled()) {
+        out << "{\"enabled\":false}";
+        return;
+    }
+
+    out << "{\"enabled\":true,\"stages\":{";
+    bool first = true;
+    for (int i = 0; i < NumOfTraceStages; i++) {
+        const LatencyHistogram &h = stages[i];
+        if (h.count() == 0) continue;
+        out << (first ? "" : ",") << "\"" << stageNames[i] << "\":{"
+            << "\"count\":" << h.count()
+            << ",\"mean_us\":" << h.mean() / 1000
+            << ",\"p50_us\":" << h.quantile(0.5) / 1000.0
+            << ",\"p90_us\":" << h.quantile(0.9) / 1000.0
+            << ",\"p99_us\":" << h.quantile(0.99) / 1000.0
+            << ",\"p999_us\":" << h.quantile(0.999) / 1000.0
+            << ",\"max_us\":" << h.max() / 1000.0 << "}";
+        first = false;
+    }
+    out << "},\"counters\":{";
+    for (int i = 0; i < NumOfTraceCounters; i++) {
+        out << (i > 0 ? "," : "") << "\"" << counterNames[i] << "\":" << counters[i].load(std::memory_order_relaxed);
+    }
+    out << "}}";
+}
+
+void writeTrace(const std::string &filename)
+{
+    std::ofstream out(filename.c_str());
+    writeTrace(out);
+    out << std::endl;
+}
+
+void resetTrace()
+{
+    for (int i = 0; i < NumOfTraceStages; i++) stages[i].reset();
+    for (int i = 0; i < NumOfTraceCounters; i++) counters[i].store(0, std::memory_order_relaxed);
+}
+
+} //namespace sse
@@ -0,0 +1,174 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <cstdint>
+
+// ----------------------------------------------------------------
+// Tracing of the hot paths: per stage latency histograms and counters.
+//
+// Only compiled in with SSE_TRACE defined (cmake -DSSE_TRACE=ON),
+// otherwise SSE_TRACE_SCOPE and friends expand to nothing. writeTrace()
+// is always available and reports whether the library records anything.
+//
+//   SSE_TRACE_SCOPE(TraceFilter);   times the rest of the block as "filter"
+//   SSE_TRACE_SWITCH(TraceSmooth);  from here on the time counts as "smooth"
+//   SSE_TRACE_COUNT(TracePostings, n);
+//
+// A scope records the total time of each of its stages once, when it ends,
+// so every call adds one value per stage to the histograms. Keep scopes out
+// of loops that run more than a few times per image or query, a scope costs
+// a clock read per switch.
+// ----------------------------------------------------------------
+
+namespace sse {
+
+enum TraceStage
+{
+    TraceDecode,
+    TraceGalif,      // all of Galif::compute
+    TraceScale,
+    TraceDetect,
+    TraceFilter,     // gabor responses, i.e. FFT or spatial convolution
+    TraceSmooth,
+    TraceHistogram,
+    TraceQuantize,
+    TraceScore,      // tf-idf weighting of the query and accumulation
+    TraceTopK,
+    TraceCreateIndex,
+    TraceSearch,     // whole query, from image to results
+    NumOfTraceStages
+};
+
+enum TraceCounter
+{
+    TraceFeatures,   // features computed
+    TracePostings,   // inverted list entries visited by queries
+    NumOfTraceCounters
+};
+
+/**
+ * @brief Histogram of latencies in nanoseconds, HDR style
+ *
+ * Buckets are exact below 32 ns, above each power of two is split into 32
+ * buckets, i.e. values are kept with about 3% precision from nanoseconds
+ * to hours in a fixed amount of memory. record() is lock free and may be
+ * called from any number of threads.
+ */
+class LatencyHistogram
+{
+public:
+    enum { SubBits = 5, SubBuckets = 1 << SubBits, MaxBits = 42,
+           NumOfBuckets = (MaxBits - SubBits + 1) * SubBuckets };
+
+    LatencyHistogram() { reset(); }
+
+    void record(uint64_t ns);
+    void reset();
+
+    uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+    uint64_t max() const { return _max.load(std::memory_order_relaxed); }
+    double mean() const;
+    // value below which the given fraction of the recorded values lie, 0 if empty
+    uint64_t quantile(double q) const;
+
+private:
+    static std::size_t bucket(uint64_t ns);
+    static uint64_t lowerBound(std::size_t bucket);
+
+    std::atomic<uint64_t> _buckets[NumOfBuckets];
+    std::atomic<uint64_t> _count;
+    std::atomic<uint64_t> _sum;
+    std::atomic<uint64_t> _max;
+};
+
+const char* traceStageName(TraceStage stage);
+const char* traceCounterName(TraceCounter counter);
+
+// whether the library was built with SSE_TRACE
+bool traceEnabled();
+
+void traceRecord(TraceStage stage, uint64_t ns);
+void traceCount(TraceCounter counter, uint64_t n);
+
+// {"enabled":true,"stages":{"galif":{"count":..,"mean_us":..,"p50_us":..,...},...},"counters":{...}}
+// or {"enabled":false}. Stages without values are left out
+void writeTrace(std::ostream &out);
+// same as above into a file, followed by a newline
+void writeTrace(const std::string &filename);
+void resetTrace();
+
+/**
+ * @brief Times the stages of one scope, see SSE_TRACE_SCOPE
+ */
+class TraceScope
+{
+public:
+    typedef std::chrono::steady_clock Clock_t;
+
+    explicit TraceScope(TraceStage stage) : _stage(stage), _start(Clock_t::now())
+    {
+        for (int i = 0; i < NumOfTraceStages; i++) _elapsed[i] = -1;
+    }
+
+    ~TraceScope()
+    {
+        switchTo(_stage);
+        for (int i = 0; i < NumOfTraceStages; i++) {
+            if (_elapsed[i] >= 0) traceRecord(static_cast<TraceStage>(i), _elapsed[i]);
+        }
+    }
+
+    // the time since the last switch counts for the current stage, from now on for stage
+    void switchTo(TraceStage stage)
+    {
+        Clock_t::time_point now = Clock_t::now();
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _start).count();
+        _elapsed[_stage] = std::max<int64_t>(_elapsed[_stage], 0) + elapsed;
+        _stage = stage;
+        _start = now;
+    }
+
+private:
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+
+    TraceStage _stage;
+    Clock_t::time_point _start;
+    // -1: stage not seen in this scope
+    int64_t _elapsed[NumOfTraceStages];
+};
+
+} //namespace sse
+
+#ifdef SSE_TRACE
+#define SSE_TRACE_SCOPE(stage) ::sse::TraceScope sse_trace_scope(::sse::stage)
+#define SSE_TRACE_SWITCH(stage) sse_trace_scope.switchTo(::sse::stage)
+#define SSE_TRACE_COUNT(counter, n) ::sse::traceCount(::sse::counter, n)
+#else
+#define SSE_TRACE_SCOPE(stage) ((void)0)
+#define SSE_TRACE_SWITCH(stage) ((void)0)
+#define SSE_TRACE_COUNT(counter, n) ((void)0)
+#endif
+
+#endif // TRACE_H
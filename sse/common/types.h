@@ -27,6 +27,8 @@
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#include "matrix.h"
+
 namespace sse {
 
 using std::vector;
@@ -41,13 +43,22 @@ typedef int64_t Index_t;
 typedef std::vector<Index_t> Vec_Index_t;
 
 typedef std::vector<float> Vec_f32_t;
-typedef std::vector<Vec_f32_t> KeyPoints_t;
-typedef std::vector<Vec_f32_t> Features_t;
+// one keypoint (x, y) resp. one descriptor per row
+typedef Matrix_f32_t KeyPoints_t;
+typedef Matrix_f32_t Features_t;
 typedef std::vector<Vec_f32_t> Vocabularys_t;
 typedef std::vector<Vec_f32_t> Samples_t; //files has been quantized.
 
+// sparse histogram of visual words: (word id, count) pairs ordered by word id
+typedef std::pair<uint, float> Term_t;
+typedef std::vector<Term_t> SparseHist_t;
+
 typedef std::pair<float, Index_t> ResultItem_t;
 
+// a sketch as drawn: every stroke is a polyline in canvas coordinates
+typedef std::vector<cv::Point2f> Stroke_t;
+typedef std::vector<Stroke_t> Strokes_t;
+
 } //namespace sse
 
 #endif // TYPES_H
@@ -15,6 +15,7 @@
  * limitations under the License.
 **************************************************************************/
 #include "detector.h"
+#include "util.h"
 
 namespace sse {
 
@@ -24,6 +25,28 @@ GridDetector::GridDetector(uint numSamples) :
 
 }
 
+// Appends the cross points of a square grid with numSamples points laid over area
+static void sample_grid(const cv::Rect &samplingArea, uint numSamples, KeyPoints_t &keypoints)
+{
+    uint numSample1D = std::ceil(std::sqrt(static_cast<float>(numSamples)));
+    float stepX = samplingArea.width / static_cast<float>(numSample1D+1);
+    float stepY = samplingArea.height / static_cast<float>(numSample1D+1);
+
+    if(keypoints.empty())
+        keypoints.create(0, 2);
+    keypoints.reserve(keypoints.size() + numSample1D*numSample1D);
+
+    for(uint x = 1; x < numSample1D; x++) {
+        uint posX = samplingArea.x + x*stepX;
+        for(uint y = 1; y <= numSample1D; y++) {
+            uint posY = samplingArea.y + y*stepY;
+            float *p = keypoints.append();
+            p[0] = posX;
+            p[1] = posY;
+        }
+    }
+}
+
 /**
  * @brief GridDetector::detect
  * Keypoints are cross points, when we divide image to square grid.
@@ -33,21 +56,71 @@ GridDetector::GridDetector(uint numSamples) :
 void GridDetector::detect(const cv::Mat &image, KeyPoints_t &keypoints) const
 {
     cv::Rect samplingArea(0, 0, image.size().width, image.size().height);
+    sample_grid(samplingArea, _numSamples, keypoints);
+}
 
-    uint numSample1D = std::ceil(std::sqrt(static_cast<float>(_numSamples)));
-    float stepX = samplingArea.width / static_cast<float>(numSample1D+1);
-    float stepY = samplingArea.height / static_cast<float>(numSample1D+1);
+StrokeDetector::StrokeDetector(uint numSamples, double featureSize, uint tiles, bool adaptive) :
+    _numSamples(numSamples), _featureSize(featureSize), _tiles(tiles), _adaptive(adaptive)
+{
 
-    for(uint x = 1; x < numSample1D; x++) {
-        uint posX = x*stepX;
-        for(uint y = 1; y <= numSample1D; y++) {
-            uint posY = y*stepY;
-            Vec_f32_t p(2);
-            p[0] = posX;
-            p[1] = posY;
-            keypoints.push_back(p);
-        }
+}
+
+/**
+ * @brief StrokeDetector::detect
+ * image is the (scaled) sketch, dark strokes on white background.
+ */
+void StrokeDetector::detect(const cv::Mat &image, KeyPoints_t &keypoints) const
+{
+    assert(image.type() == CV_8UC1);
+
+    // same patch size as Galif::extract
+    int featureSize = std::sqrt(image.size().area() * _featureSize);
+    if (featureSize % _tiles)
+    {
+        featureSize += _tiles - (featureSize % _tiles);
+    }
+
+    cv::Rect imageArea(0, 0, image.cols, image.rows);
+    cv::Rect samplingArea = imageArea;
+
+    if (_adaptive)
+    {
+        cv::Rect strokes = strokeBoundingBox(image);
+
+        // empty sketch, nothing to detect
+        if (strokes.area() == 0) return;
+
+        // grow by half a patch, so that the outer keypoints still see the strokes at their patch border
+        samplingArea = cv::Rect(strokes.x - featureSize/2, strokes.y - featureSize/2,
+                                strokes.width + featureSize, strokes.height + featureSize) & imageArea;
+    }
+
+    // sum of the pixel values, a patch without strokes sums up to 255 * area
+    cv::Mat_<int> integral;
+    cv::integral(image, integral, CV_32S);
+
+    size_t first = keypoints.size();
+    sample_grid(samplingArea, _numSamples, keypoints);
+
+    // keep the keypoints whose patch contains strokes, compacting them in place
+    size_t kept = first;
+    for (size_t i = first; i < keypoints.size(); i++) {
+        const float *keypoint = keypoints.row(i);
+
+        cv::Rect rect(keypoint[0] - featureSize/2, keypoint[1] - featureSize/2, featureSize, featureSize);
+        cv::Rect isec = rect & imageArea;
+
+        int patchsum = integral(isec.tl())
+                + integral(isec.br())
+                - integral(isec.y, isec.x + isec.width)
+                - integral(isec.y + isec.height, isec.x);
+
+        if (patchsum == 255 * isec.area()) continue;
+
+        if (kept != i) std::copy(keypoint, keypoint + 2, keypoints.row(kept));
+        kept++;
     }
+    keypoints.resize(kept);
 }
 
 } //namespace sse
@@ -39,6 +39,26 @@ private:
     uint _numSamples;
 };
 
+/**
+ * @brief Grid detector that only keeps the keypoints whose patch contains strokes
+ *
+ * Uses the same grid and patch size as GridDetector + Galif::extract, so the
+ * result equals the grid keypoints minus those Galif would mark as empty. With
+ * adaptive = true the grid is spread over the bounding box of the strokes
+ * instead of the whole image, so small sketches get as many keypoints as
+ * sketches filling the canvas.
+ */
+class StrokeDetector : public Detector {
+public:
+    StrokeDetector(uint numSamples = 625, double featureSize = 0.1, uint tiles = 4, bool adaptive = false);
+    void detect(const cv::Mat &image, KeyPoints_t &keypoints) const;
+private:
+    uint _numSamples;
+    double _featureSize;
+    uint _tiles;
+    bool _adaptive;
+};
+
 } //namespace sse
 
 
@@ -0,0 +1,302 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include "gabor.h"
+
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+
+namespace sse {
+
+namespace {
+
+typedef std::tuple<uint, uint, double, double, double, int> Key_t;
+
+struct Registry
+{
+    std::mutex mutex;
+    std::map<Key_t, std::shared_ptr<const GaborFilterBank> > banks;
+    std::string cacheDirectory;
+    bool cacheDirectorySet;
+
+    Registry() : cacheDirectorySet(false) {}
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+const char FileMagic[8] = { 'S', 'S', 'E', 'G', 'A', 'B', 'O', '1' };
+
+/**
+ * Fills one gabor filter in the frequency domain. The filter is the sum of the
+ * gaussian over a 3x3 tiling of the unit frequency square, which avoids
+ * discontinuities at the borders.
+ *
+ * The exponent of each tile is computed with plain arithmetic in one pass that
+ * the compiler can vectorize, then cv::exp evaluates all of it at once.
+ */
+void generate_gabor_filter(cv::Mat_<double> &filter, double peakFrequency, double theta, double sigmaX, double sigmaY)
+{
+    const int w = filter.cols;
+    const int h = filter.rows;
+    const double step_u = 1.0 / static_cast<double>(w);
+    const double step_v = 1.0 / static_cast<double>(h);
+    const double cos_theta = std::cos(theta);
+    const double sin_theta = std::sin(theta);
+
+    const double sigmaXSquared = sigmaX*sigmaX;
+    const double sigmaYSquared = sigmaY*sigmaY;
+    const double scale = -2*M_PI*M_PI;
+
+    filter.setTo(cv::Scalar(0));
+
+    cv::Mat_<double> exponent(h, w);
+    std::vector<double> us(w);
+
+    for(int ny = -1; ny <= 1; ny++) {
+        for(int nx = -1; nx <= 1; nx++) {
+            for(int x = 0; x < w; x++) us[x] = nx + x*step_u;
+
+            for(int y = 0; y < h; y++) {
+                const double v = ny + y*step_v;
+                const double v_sin = v*sin_theta;
+                const double v_cos = v*cos_theta;
+                double *e = exponent[y];
+                for(int x = 0; x < w; x++) {
+                    double ur = us[x]*cos_theta - v_sin;
+                    double vr = us[x]*sin_theta + v_cos;
+
+                    double temp = ur - peakFrequency;
+                    e[x] = scale*(temp*temp*sigmaXSquared + vr*vr*sigmaYSquared);
+                }
+            }
+
+            cv::exp(exponent, exponent);
+            filter += exponent;
+        }
+    }
+}
+
+/**
+ * Value of the filter generated by generate_gabor_filter at frequency (0, 0)
+ */
+double gabor_dc_gain(double peakFrequency, double theta, double sigmaX, double sigmaY)
+{
+    double gain = 0;
+    for(int ny = -1; ny <= 1; ny++) {
+        for(int nx = -1; nx <= 1; nx++) {
+            double ur = nx*std::cos(theta) - ny*std::sin(theta);
+            double vr = nx*std::sin(theta) + ny*std::cos(theta);
+            double temp = ur - peakFrequency;
+            gain += std::exp(-2*M_PI*M_PI*(temp*temp*sigmaX*sigmaX + vr*vr*sigmaY*sigmaY));
+        }
+    }
+    return gain;
+}
+
+} //namespace
+
+std::shared_ptr<const GaborFilterBank> GaborFilterBank::get(uint width, uint numOrients,
+                                                            double peakFrequency, double lineWidth, double lambda,
+                                                            int filterSize)
+{
+    Registry &r = registry();
+    if(filterSize == 0)
+        filterSize = paddedSize(width, width, lineWidth, lambda);
+    Key_t key(width, numOrients, peakFrequency, lineWidth, lambda, filterSize);
+
+    // the lock is held while generating, so that concurrent
+    // Galif constructors wait for one bank instead of all computing it
+    std::lock_guard<std::mutex> locker(r.mutex);
+
+    std::map<Key_t, std::shared_ptr<const GaborFilterBank> >::const_iterator it = r.banks.find(key);
+    if(it != r.banks.end())
+        return it->second;
+
+    if(!r.cacheDirectorySet) {
+        const char *env = std::getenv("OPENSSE_FILTER_CACHE");
+        r.cacheDirectory = env ? env : "";
+        r.cacheDirectorySet = true;
+    }
+
+    std::shared_ptr<GaborFilterBank> bank(new GaborFilterBank(width, numOrients, peakFrequency, lineWidth, lambda, filterSize));
+
+    double sigmaX = lineWidth * width;
+    double sigmaY = lambda * sigmaX;
+
+    std::string filename;
+    if(!r.cacheDirectory.empty()) {
+        char name[256];
+        snprintf(name, sizeof(name), "/gabor_%u_%u_%.17g_%.17g_%.17g_%d.bin", width, numOrients, peakFrequency, lineWidth, lambda, filterSize);
+        filename = r.cacheDirectory + name;
+    }
+
+    if(filename.empty() || !bank->load(filename)) {
+        bank->generate(peakFrequency, sigmaX, sigmaY);
+        if(!filename.empty())
+            bank->save(filename);
+    }
+    bank->generateSpatial(peakFrequency, sigmaX, sigmaY);
+
+    r.banks[key] = bank;
+    return bank;
+}
+
+void GaborFilterBank::setCacheDirectory(const std::string &directory)
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> locker(r.mutex);
+    r.cacheDirectory = directory;
+    r.cacheDirectorySet = true;
+}
+
+int GaborFilterBank::paddedSize(int extent, uint width, double lineWidth, double lambda)
+{
+    double sigmaX = lineWidth * width;
+    double sigmaY = lambda * sigmaX;
+
+    // pad the image by 3*sigma_max, this avoids any boundary effects
+    // afterwards increase size to something that fft is working efficiently on
+    return cv::getOptimalDFTSize(extent + 3*std::max(sigmaX, sigmaY));
+}
+
+GaborFilterBank::GaborFilterBank(uint /*width*/, uint numOrients, double /*peakFrequency*/, double /*lineWidth*/, double /*lambda*/,
+                                 int filterSize)
+{
+    _filterSize = cv::Size(filterSize, filterSize);
+    _filters.resize(numOrients);
+    _spatialRadius = 0;
+}
+
+void GaborFilterBank::generate(double peakFrequency, double sigmaX, double sigmaY)
+{
+    cv::Mat_<double> real(_filterSize);
+    cv::Mat zero = cv::Mat::zeros(_filterSize, CV_64FC1);
+
+    for(uint i = 0; i < _filters.size(); i++) {
+        double theta = i * M_PI / _filters.size();
+
+        generate_gabor_filter(real, peakFrequency, theta, sigmaX, sigmaY);
+        real(0, 0) = 0;
+
+        // the filters are real, the complex part stays 0
+        std::vector<cv::Mat> channels;
+        channels.push_back(real);
+        channels.push_back(zero);
+        cv::Mat filter;
+        cv::merge(channels, filter);
+        _filters[i] = filter;
+    }
+}
+
+/**
+ * The frequency domain filter is a gaussian centered at the peak frequency on the
+ * rotated u axis, so in the spatial domain it is a normalized gaussian with the
+ * same sigmas, modulated by a complex carrier of the peak frequency:
+ *
+ *   h(x, y) = 1/(2 pi sigmaX sigmaY) exp(-xr^2/(2 sigmaX^2) - yr^2/(2 sigmaY^2)) exp(i 2 pi f xr)
+ */
+void GaborFilterBank::generateSpatial(double peakFrequency, double sigmaX, double sigmaY)
+{
+    _spatialRadius = std::ceil(3*std::max(sigmaX, sigmaY));
+    const int size = 2*_spatialRadius + 1;
+    const double norm = 1.0 / (2*M_PI*sigmaX*sigmaY);
+
+    _spatialFilters.resize(_filters.size());
+    _dcGains.resize(_filters.size());
+    for(uint i = 0; i < _filters.size(); i++) {
+        double theta = i * M_PI / _filters.size();
+        double cos_theta = std::cos(theta);
+        double sin_theta = std::sin(theta);
+
+        Filter_t &kernel = _spatialFilters[i];
+        kernel.create(size, size);
+        for(int y = -_spatialRadius; y <= _spatialRadius; y++) {
+            for(int x = -_spatialRadius; x <= _spatialRadius; x++) {
+                double xr = x*cos_theta - y*sin_theta;
+                double yr = x*sin_theta + y*cos_theta;
+                double envelope = norm * std::exp(-xr*xr/(2*sigmaX*sigmaX) - yr*yr/(2*sigmaY*sigmaY));
+                kernel(y + _spatialRadius, x + _spatialRadius) = std::polar(envelope, 2*M_PI*peakFrequency*xr);
+            }
+        }
+
+        _dcGains[i] = gabor_dc_gain(peakFrequency, theta, sigmaX, sigmaY);
+    }
+}
+
+bool GaborFilterBank::load(const std::string &filename)
+{
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if(!in)
+        return false;
+
+    char magic[sizeof(FileMagic)];
+    int32_t header[3];
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if(!in || !std::equal(magic, magic + sizeof(magic), FileMagic)
+            || header[0] != _filterSize.height || header[1] != _filterSize.width
+            || header[2] != static_cast<int32_t>(_filters.size()))
+        return false;
+
+    std::vector<Filter_t> filters(_filters.size());
+    for(uint i = 0; i < filters.size(); i++) {
+        filters[i].create(_filterSize.height, _filterSize.width);
+        for(int r = 0; r < filters[i].rows; r++) {
+            in.read(reinterpret_cast<char*>(filters[i][r]), filters[i].cols * sizeof(std::complex<double>));
+        }
+    }
+    if(!in)
+        return false;
+
+    _filters = filters;
+    return true;
+}
+
+void GaborFilterBank::save(const std::string &filename) const
+{
+    // write to a temporary file first, so that processes starting
+    // at the same time never read a partially written bank
+    std::string temp = filename + "." + std::to_string(getpid()) + ".tmp";
+    std::ofstream out(temp.c_str(), std::ios::binary);
+    if(!out)
+        return;
+
+    int32_t header[3] = { _filterSize.height, _filterSize.width, static_cast<int32_t>(_filters.size()) };
+    out.write(FileMagic, sizeof(FileMagic));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    for(uint i = 0; i < _filters.size(); i++) {
+        for(int r = 0; r < _filters[i].rows; r++) {
+            out.write(reinterpret_cast<const char*>(_filters[i][r]), _filters[i].cols * sizeof(std::complex<double>));
+        }
+    }
+    out.close();
+
+    if(out)
+        std::rename(temp.c_str(), filename.c_str());
+    else
+        std::remove(temp.c_str());
+}
+
+} //namespace sse
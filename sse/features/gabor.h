@@ -0,0 +1,92 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#ifndef GABOR_H
+#define GABOR_H
+
+#include "../common/types.h"
+
+#include <complex>
+#include <memory>
+
+namespace sse {
+
+/**
+ * @brief The GaborFilterBank class
+ * Frequency domain gabor filters of one orientation each, as used by Galif.
+ *
+ * Generating the filters is by far the most expensive part of constructing
+ * a Galif, so filter banks are shared: get() returns the bank of the given
+ * parameters from a process-wide registry and only generates it on first use.
+ * If a cache directory is set (setCacheDirectory or the environment variable
+ * OPENSSE_FILTER_CACHE) banks are also stored there and loaded from disk by
+ * later processes.
+ *
+ * The filters are defined in cycles per pixel, so a bank generated at another
+ * (DFT) size holds the same spatial filters. filterSize = 0 selects the default
+ * size for images of up to width x width pixels.
+ *
+ * Each bank also holds the spatial domain kernels of its filters, for
+ * convolving sparse sketches directly (see Galif, responseEngine).
+ */
+class GaborFilterBank
+{
+public:
+    typedef cv::Mat_<std::complex<double> > Filter_t;
+
+    static std::shared_ptr<const GaborFilterBank> get(uint width, uint numOrients,
+                                                      double peakFrequency, double lineWidth, double lambda,
+                                                      int filterSize = 0);
+
+    // smallest filter size at which images of extent x extent pixels can be filtered
+    // without boundary effects, rounded up to a DFT friendly size
+    static int paddedSize(int extent, uint width, double lineWidth, double lambda);
+
+    // empty directory disables the disk cache
+    static void setCacheDirectory(const std::string &directory);
+
+    // padded size of the filters, images are filtered at that size
+    const cv::Size& filterSize() const { return _filterSize; }
+    uint numOrients() const { return _filters.size(); }
+    const Filter_t& filter(uint orient) const { return _filters[orient]; }
+
+    // spatial kernel of a filter, (2*spatialRadius()+1)^2 taps with the origin in the center,
+    // truncated at 3 sigma
+    int spatialRadius() const { return _spatialRadius; }
+    const Filter_t& spatialFilter(uint orient) const { return _spatialFilters[orient]; }
+
+    // response of a filter to a constant image before the DC component was removed,
+    // the spatial kernels still contain it
+    double dcGain(uint orient) const { return _dcGains[orient]; }
+
+private:
+    GaborFilterBank(uint width, uint numOrients, double peakFrequency, double lineWidth, double lambda, int filterSize);
+
+    void generate(double peakFrequency, double sigmaX, double sigmaY);
+    void generateSpatial(double peakFrequency, double sigmaX, double sigmaY);
+    bool load(const std::string &filename);
+    void save(const std::string &filename) const;
+
+    cv::Size _filterSize;
+    std::vector<Filter_t> _filters;
+    int _spatialRadius;
+    std::vector<Filter_t> _spatialFilters;
+    std::vector<double> _dcGains;
+};
+
+} //namespace sse
+
+#endif // GABOR_H
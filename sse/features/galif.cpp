@@ -17,88 +17,231 @@
 #include "galif.h"
 
 #include "util.h"
+#include "../common/trace.h"
 
 #include <limits>
 #include <stdexcept>
 
 namespace sse {
 
-template <class T>
-void generate_gabor_filter(cv::Mat_<T> &image, double peakFrequency, double theta, double sigmaX, double sigmaY)
+/**
+ * Recursive gaussian filter (Young & van Vliet - Recursive implementation of the
+ * Gaussian filter, 1995). A causal and an anti-causal third order recursion per
+ * axis, so the cost per pixel does not depend on sigma. Borders are replicated.
+ */
+static void recursive_gaussian_blur(cv::Mat &image, double sigma)
 {
-    const uint w = image.size().width;
-    const uint h = image.size().height;
-    const double step_u = 1.0 / static_cast<double>(w);
-    const double step_v = 1.0 / static_cast<double>(h);
-    const double cos_theta = std::cos(theta);
-    const double sin_theta = std::sin(theta);
-
-    const double sigmaXSquared = sigmaX*sigmaX;
-    const double sigmaYSquared = sigmaY*sigmaY;
-
-    image.setTo(cv::Scalar(0));
-
-    for(int ny = -1; ny <= 1; ny++) {
-        for(int nx = -1; nx <=1; nx++) {
-            double v = ny;
-            for(uint y = 0; y < h; y++) {
-                double u = nx;
-                for(uint x = 0; x < w; x++) {
-                    double ur = u*cos_theta - v*sin_theta;
-                    double vr = u*sin_theta + v*cos_theta;
-
-                    double temp = ur - peakFrequency;
-                    double value = std::exp(-2*M_PI*M_PI*(temp*temp*sigmaXSquared + vr*vr*sigmaYSquared));
-                    image(y, x) += value;
-
-                    u += step_u;
+    assert(image.type() == CV_32FC1);
+
+    double q = (sigma >= 2.5) ? 0.98711*sigma - 0.96330
+                              : 3.97156 - 4.14554*std::sqrt(1.0 - 0.26891*std::max(sigma, 0.5));
+    double b0 = 1.57825 + 2.44413*q + 1.4281*q*q + 0.422205*q*q*q;
+    const float b1 = (2.44413*q + 2.85619*q*q + 1.26661*q*q*q) / b0;
+    const float b2 = -(1.4281*q*q + 1.26661*q*q*q) / b0;
+    const float b3 = (0.422205*q*q*q) / b0;
+    const float B = 1.0 - (b1 + b2 + b3);
+
+    const int rows = image.rows;
+    const int cols = image.cols;
+
+    // along the rows
+    for (int r = 0; r < rows; r++) {
+        float *p = image.ptr<float>(r);
+
+        float w1 = p[0], w2 = p[0], w3 = p[0];
+        for (int c = 0; c < cols; c++) {
+            float w = B*p[c] + b1*w1 + b2*w2 + b3*w3;
+            p[c] = w; w3 = w2; w2 = w1; w1 = w;
+        }
+        w1 = w2 = w3 = p[cols-1];
+        for (int c = cols-1; c >= 0; c--) {
+            float w = B*p[c] + b1*w1 + b2*w2 + b3*w3;
+            p[c] = w; w3 = w2; w2 = w1; w1 = w;
+        }
+    }
+
+    // along the columns, one whole row at a time so that the inner loop is contiguous
+    for (int r = 0; r < rows; r++) {
+        float *p = image.ptr<float>(r);
+        const float *p1 = image.ptr<float>(std::max(r-1, 0));
+        const float *p2 = image.ptr<float>(std::max(r-2, 0));
+        const float *p3 = image.ptr<float>(std::max(r-3, 0));
+        if (r == 0) p1 = p2 = p3 = p; // replicated border: w[-k] = x[0], w[0] = x[0]
+        for (int c = 0; c < cols; c++) {
+            p[c] = B*p[c] + b1*p1[c] + b2*p2[c] + b3*p3[c];
+        }
+    }
+    for (int r = rows-1; r >= 0; r--) {
+        float *p = image.ptr<float>(r);
+        const float *p1 = image.ptr<float>(std::min(r+1, rows-1));
+        const float *p2 = image.ptr<float>(std::min(r+2, rows-1));
+        const float *p3 = image.ptr<float>(std::min(r+3, rows-1));
+        if (r == rows-1) p1 = p2 = p3 = p;
+        for (int c = 0; c < cols; c++) {
+            p[c] = B*p[c] + b1*p1[c] + b2*p2[c] + b3*p3[c];
+        }
+    }
+}
+
+/**
+ * Approximates a gaussian of the given sigma, truncated at kernel radius
+ * 'radius', by a weighted sum of three centered squares. The weights are a
+ * least squares fit to the kernel, scaled such that the sum stays 1.
+ */
+static void fit_box_kernel(int radius, double sigma, int radii[3], double weights[3])
+{
+    const double factors[3] = { 0.8, 1.6, 2.5 };
+    for (int i = 0; i < 3; i++) {
+        radii[i] = static_cast<int>(factors[i] * sigma + 0.5);
+        if (i > 0 && radii[i] <= radii[i-1]) radii[i] = radii[i-1] + 1;
+    }
+
+    // normal equations A w = b of the least squares fit
+    double A[3][4] = { { 0 } };
+    double gaussSum = 0;
+    for (int y = -radius; y <= radius; y++) {
+        for (int x = -radius; x <= radius; x++) {
+            double g = std::exp(-(x*x + y*y) / (2*sigma*sigma));
+            gaussSum += g;
+            for (int i = 0; i < 3; i++) {
+                if (std::abs(x) > radii[i] || std::abs(y) > radii[i]) continue;
+                for (int j = 0; j < 3; j++) {
+                    if (std::abs(x) <= radii[j] && std::abs(y) <= radii[j]) A[i][j] += 1;
                 }
-                v += step_v;
+                A[i][3] += g;
             }
         }
     }
+
+    // gaussian elimination, A is symmetric positive definite
+    for (int i = 0; i < 3; i++) {
+        for (int r = i+1; r < 3; r++) {
+            double f = A[r][i] / A[i][i];
+            for (int c = i; c < 4; c++) A[r][c] -= f * A[i][c];
+        }
+    }
+    for (int i = 2; i >= 0; i--) {
+        double v = A[i][3];
+        for (int c = i+1; c < 3; c++) v -= A[i][c] * weights[c];
+        weights[i] = v / A[i][i];
+    }
+
+    double sum = 0;
+    for (int i = 0; i < 3; i++) {
+        double side = 2*radii[i] + 1;
+        sum += weights[i] * side * side;
+    }
+    for (int i = 0; i < 3; i++) weights[i] /= sum;
 }
 
+// sum of image values in the square of the given radius around (y, x), from its integral image
+static inline double box_sum(const cv::Mat_<double> &integral, int y, int x, int radius)
+{
+    int y0 = std::max(y - radius, 0), y1 = std::min(y + radius + 1, integral.rows - 1);
+    int x0 = std::max(x - radius, 0), x1 = std::min(x + radius + 1, integral.cols - 1);
+    return integral(y1, x1) - integral(y0, x1) - integral(y1, x0) + integral(y0, x0);
+}
+
+// Sets the border of width border around the image to 0
+static void zero_frame(cv::Mat &framed, int border)
+{
+    for (int r = 0; r < framed.rows; r++) {
+        float *row = framed.ptr<float>(r);
+        if (r < border || r >= framed.rows - border) {
+            std::fill(row, row + framed.cols, 0.0f);
+        }
+        else {
+            std::fill(row, row + border, 0.0f);
+            std::fill(row + framed.cols - border, row + framed.cols, 0.0f);
+        }
+    }
+}
+
+/**
+ * Adds the kernel, weighted by the amount of ink, around every ink pixel,
+ * i.e. convolves the ink with the kernel. Only dst is written, kernel taps
+ * outside of it are skipped.
+ */
+static void convolve_ink(const std::vector<cv::Point> &positions, const std::vector<double> &weights,
+                         const GaborFilterBank::Filter_t &kernel, int radius,
+                         cv::Mat_<std::complex<double> > &dst)
+{
+    for (size_t i = 0; i < positions.size(); i++) {
+        const cv::Point &p = positions[i];
+        const double w = weights[i];
+
+        int y0 = std::max(p.y - radius, 0), y1 = std::min(p.y + radius + 1, dst.rows);
+        int x0 = std::max(p.x - radius, 0), x1 = std::min(p.x + radius + 1, dst.cols);
+        for (int y = y0; y < y1; y++) {
+            std::complex<double> *d = dst[y] + x0;
+            const std::complex<double> *k = kernel[y - p.y + radius] + x0 - p.x + radius;
+            for (int x = 0; x < x1 - x0; x++) {
+                d[x] += w * k[x];
+            }
+        }
+    }
+}
+
+// Rough operation counts (real flops) of the two ways to compute the responses:
+// one forward plus one inverse FFT per orientation, spectrum product and
+// magnitude, against one complex multiply-add per kernel tap and ink pixel.
+// Compare both with tools/gabor_benchmark.cpp when changing the engines.
+static const double FftFlopsPerSample = 5.0;      // times log2 of the size
+static const double ProductFlopsPerSample = 12.0; // spectrum product and magnitude
+static const double SpatialFlopsPerTap = 4.0;
+
+static bool spatial_is_cheaper(size_t inkPixels, int radius, const cv::Size &filterSize, uint numOrients)
+{
+    double n = filterSize.area();
+    double fftCost = (numOrients + 1) * FftFlopsPerSample * n * std::log2(n)
+            + numOrients * ProductFlopsPerSample * n;
+
+    double taps = (2*radius + 1) * (2*radius + 1);
+    double spatialCost = numOrients * SpatialFlopsPerTap * taps * inkPixels;
+
+    return spatialCost < fftCost;
+}
 
 Galif::Galif(uint width, uint numOrients, uint tiles,
              double peakFrequency, double lineWidth, double lambda,
              double featureSize, bool isSmoothHist,
              const std::string &normalizeHist,
              const std::string &detectorName,
-             uint numOfSamples)
+             uint numOfSamples,
+             const std::string &smoothHist,
+             bool cropToStrokes,
+             const std::string &responseEngine)
     : _width(width), _numOrients(numOrients), _tiles(tiles)
     , _peakFrequency(peakFrequency), _lineWidth(lineWidth), _lambda(lambda)
     , _featureSize(featureSize), _isSmoothHist(isSmoothHist)
     , _normalizeHist(normalizeHist), _detectorName(detectorName)
+    , _smoothHist(smoothHist), _cropToStrokes(cropToStrokes)
+    , _responseEngine(responseEngine), _numOfSamples(numOfSamples)
 {
-    _detector = new GridDetector(numOfSamples);
-
-    double sigmaX = _lineWidth * _width;
-    double sigmaY = _lambda * sigmaX;
-
-    // pad the image by 3*sigma_max, this avoids any boundary effects
-    // afterwards increase size to something that fft is working efficiently on
-    int paddedSize = cv::getOptimalDFTSize(_width + 3*std::max(sigmaX, sigmaY));
-    //std::cout << "galo padded size: " << paddedSize << std::endl;
-
-    _filterSize = cv::Size(paddedSize, paddedSize);
-
-    for(uint i = 0; i < _numOrients; i++) {
-        cv::Mat_<std::complex<double> > filter(_filterSize);
-        double theta = i * M_PI / _numOrients;
-
-        generate_gabor_filter(filter, _peakFrequency, theta, sigmaX, sigmaY);
-
-        filter(0, 0) = 0;
-        _gaborFilter.push_back(filter);
-    }
+    if (_smoothHist != "gaussian" && _smoothHist != "recursive" && _smoothHist != "boxes")
+        throw std::runtime_error("unsupported histogram smoothing method passed (" + _smoothHist + ")." + "Allowed methods are : gaussian, recursive, boxes." );
+    if (_responseEngine != "auto" && _responseEngine != "fft" && _responseEngine != "spatial")
+        throw std::runtime_error("unsupported response engine passed (" + _responseEngine + ")." + "Allowed engines are : auto, fft, spatial." );
+
+    if (_detectorName == "grid")
+        _detector = new GridDetector(numOfSamples);
+    else if (_detectorName == "stroke")
+        _detector = new StrokeDetector(numOfSamples, _featureSize, _tiles, false);
+    else if (_detectorName == "stroke-adaptive")
+        _detector = new StrokeDetector(numOfSamples, _featureSize, _tiles, true);
+    else
+        throw std::runtime_error("unsupported detector passed (" + _detectorName + ")." + "Allowed detectors are : grid, stroke, stroke-adaptive." );
+
+    // filters are shared by all Galif instances with the same parameters
+    _filterBank = GaborFilterBank::get(_width, _numOrients, _peakFrequency, _lineWidth, _lambda);
+    _filterSize = _filterBank->filterSize();
 //#define __DEBUG__
 #ifdef __DEBUG__
     //output the filters
     for(uint i = 0; i < _numOrients; i++) {
         char filename[64];
         sprintf(filename, "filter_%d.png", i);
-        const cv::Mat_<std::complex<double> >& filter = _gaborFilter[i];
+        const cv::Mat_<std::complex<double> >& filter = _filterBank->filter(i);
 
         //compute magnitude of response
         cv::Mat mag(filter.size(), CV_32FC1);
@@ -118,49 +261,70 @@ Galif::Galif(uint width, uint numOrients, uint tiles,
 
 /**
  * @brief Galif::compute
- * @param image : input image (3-channel image, make sure  image.type() == CV_8UC3)
+ * @param image : input image, CV_8UC1 (gray or binary) or CV_8UC3
  * @param keypoints : output, has been normalized in range [0,1]x[0,1], so that they are independent of image size
  * @param features : output, Galif features
  */
 void Galif::compute(const cv::Mat &image, KeyPoints_t &keypoints, Features_t &features) const
 {
+    // one workspace per thread, shared by all Galif instances
+    static thread_local GalifWorkspace workspace;
+    compute(image, keypoints, features, workspace);
+}
+
+void Galif::compute(const cv::Mat &image, KeyPoints_t &keypoints, Features_t &features, GalifWorkspace &workspace) const
+{
+    SSE_TRACE_SCOPE(TraceGalif);
+
     // --------------------------------------------------------------
     // prerequisites:
     //
-    // this generator expects a 3-channel image, with
-    // each channel containing exactly the same pixel values
+    // this generator expects a single channel image, or a 3-channel
+    // image with each channel containing exactly the same pixel values
     //
     // the image must have a white background with black sketch lines
     // --------------------------------------------------------------
-    assert(image.type() == CV_8UC3);
-
-    cv::Mat gray;
-    cv::cvtColor(image, gray, CV_RGB2GRAY);
-
-    assert(gray.type() == CV_8UC1);
 
     // scale image to desired size
-    cv::Mat scaled;
-    scale(gray, scaled);
+    cv::Mat &scaled = workspace._scaled;
+    scaleGray(image, workspace._gray, scaled);
+
+    // with _cropToStrokes move the strokes to the center of the image,
+    // so that the descriptors do not depend on where the user drew
+    const cv::Mat *sketch = &scaled;
+    if (_cropToStrokes) {
+        cv::Rect strokes = strokeBoundingBox(scaled);
+        if (strokes.area() > 0) {
+            cv::Mat &recentred = workspace._recentred;
+            recentred.create(scaled.size(), CV_8UC1);
+            recentred.setTo(cv::Scalar(255));
+            cv::Rect centered((scaled.cols - strokes.width) / 2, (scaled.rows - strokes.height) / 2,
+                              strokes.width, strokes.height);
+            cv::Mat strokes_in_center = recentred(centered);
+            scaled(strokes).copyTo(strokes_in_center);
+            sketch = &recentred;
+        }
+    }
 
     // detect keypoints on the scaled image
     // the keypoint cooredinates lie in the domain defined by
     // the scaled image size, i.e. if the image has been scaled
     // to 256x256, keypoint coordinates lie in [0,255]x[0,255]
-    KeyPoints_t _keypoints;
-    detect(scaled, _keypoints);
+    KeyPoints_t &_keypoints = workspace._keypoints;
+    _keypoints.clear();
+    detect(*sketch, _keypoints);
 
     //extract local features at the given keypoints
-    Features_t _features;
-    std::vector<Index_t> emptyFeatures;
-    extract(scaled, _keypoints, _features, emptyFeatures);
+    Features_t &_features = workspace._features;
+    std::vector<Index_t> &emptyFeatures = workspace._emptyFeatures;
+    extract(*sketch, _keypoints, _features, emptyFeatures, workspace);
 
     assert(_features.size() == _keypoints.size());
     assert(emptyFeatures.size() == _keypoints.size());
 
     // normalize keypoints to range [0,1]x[0,1] so they are
     // independent of image size
-    KeyPoints_t keypointsNormalized;
+    KeyPoints_t &keypointsNormalized = workspace._keypointsNormalized;
     normalizeKeypoints(_keypoints, scaled.size(), keypointsNormalized);
 
     // remove features that are empty, i.e. that contain
@@ -170,11 +334,12 @@ void Galif::compute(const cv::Mat &image, KeyPoints_t &keypoints, Features_t &fe
 
     //if no sketch stroke in image, set one feature histogram all [0].
     if(features.size() == 0) {
-        Vec_f32_t histogram(_tiles * _tiles * _numOrients, 0.0f);
-        Vec_f32_t zero(2, 0.0f);
-        features.push_back(histogram);
-        keypoints.push_back(zero);
+        features.create(1, _tiles * _tiles * _numOrients);
+        keypoints.create(1, 2);
+        std::fill(features.data(), features.data() + features.cols(), 0.0f);
+        std::fill(keypoints.data(), keypoints.data() + keypoints.cols(), 0.0f);
     }
+    SSE_TRACE_COUNT(TraceFeatures, features.size());
 }
 
 double Galif::scale(const cv::Mat &image, cv::Mat &scaled) const
@@ -189,8 +354,25 @@ double Galif::scale(const cv::Mat &image, cv::Mat &scaled) const
     return scaling_factor;
 }
 
+void Galif::scaleGray(const cv::Mat &image, cv::Mat &gray, cv::Mat &scaled) const
+{
+    SSE_TRACE_SCOPE(TraceScale);
+    assert(image.type() == CV_8UC1 || image.type() == CV_8UC3);
+
+    // sketches are usually decoded to one channel already, these are scaled right away
+    if (image.channels() == 1) {
+        scale(image, scaled);
+    }
+    else {
+        cv::cvtColor(image, gray, CV_RGB2GRAY);
+        scale(gray, scaled);
+    }
+    assert(scaled.type() == CV_8UC1);
+}
+
 void Galif::detect(const cv::Mat &image, KeyPoints_t &keypoints) const
 {
+    SSE_TRACE_SCOPE(TraceDetect);
     assert(image.type() == CV_8UC1);
     assertImageSize(image);
 
@@ -199,92 +381,199 @@ void Galif::detect(const cv::Mat &image, KeyPoints_t &keypoints) const
 
 void Galif::extract(const cv::Mat &image, const KeyPoints_t &keypoints, Features_t &features, Vec_Index_t &emptyFeatures) const
 {
+    static thread_local GalifWorkspace workspace;
+    extract(image, keypoints, features, emptyFeatures, workspace);
+}
+
+void Galif::extract(const cv::Mat &image, const KeyPoints_t &keypoints, Features_t &features, Vec_Index_t &emptyFeatures,
+                    GalifWorkspace &workspace) const
+{
+    SSE_TRACE_SCOPE(TraceFilter);
     assert(image.type() == CV_8UC1);
     assertImageSize(image);
 
-    // copy input image centered onto a white background image with
-    // exactly the size of our gabor filters
+    // all buffers below come from the workspace, create() only
+    // allocates when the size differs from the previous image
+
+    int featureSize = patchSize(image.size());
+    int tileSize = featureSize / _tiles;
+    float halfTileSize = (float) tileSize / 2;
+
+    // region of the image that is filtered. Normally all of it, with
+    // _cropToStrokes only the strokes plus everything a non empty patch
+    // (and the smoothing of its responses) can reach. Every other patch is
+    // empty anyway. The crop is filtered with a smaller filter bank, which
+    // cuts the FFT cost for sketches that only cover a part of the canvas.
+    cv::Rect roi(0, 0, image.cols, image.rows);
+    const GaborFilterBank *filterBank = _filterBank.get();
+    std::shared_ptr<const GaborFilterBank> roiFilterBank;
+    if (_cropToStrokes)
+    {
+        cv::Rect strokes = strokeBoundingBox(image);
+        int margin = featureSize + tileSize;
+        cv::Rect crop = cv::Rect(strokes.x - margin, strokes.y - margin,
+                                 strokes.width + 2*margin, strokes.height + 2*margin) & roi;
+
+        // round the extent up to 1/8th of the width, this limits the number of filter banks
+        int step = std::max(1u, _width / 8);
+        int extent = std::max(crop.width, crop.height);
+        extent = (extent + step - 1) / step * step;
+        int filterSize = GaborFilterBank::paddedSize(extent, _width, _lineWidth, _lambda);
+
+        if (strokes.area() > 0 && filterSize < _filterSize.width)
+        {
+            roi = crop;
+            roiFilterBank = GaborFilterBank::get(_width, _numOrients, _peakFrequency, _lineWidth, _lambda, filterSize);
+            filterBank = roiFilterBank.get();
+        }
+    }
+    const cv::Size &filterSize = filterBank->filterSize();
+
+    // inverted image (region), i.e. the ink, on a black background
+    // with exactly the size of our gabor filters
     // WARNING: white background assumed!!!
-    cv::Mat_<std::complex<double> > src(_filterSize, 1.0);
-    cv::Mat_<unsigned char> inverted = cv::Mat_<unsigned char>::zeros(_filterSize);
-    for (int r = 0; r < image.rows; r++) {
-        for (int c = 0; c < image.cols; c++)
+    cv::Mat_<unsigned char> &inverted = workspace._inverted;
+    inverted.create(filterSize.height, filterSize.width);
+    inverted.setTo(cv::Scalar(0));
+    size_t inkPixels = 0;
+    for (int r = 0; r < roi.height; r++) {
+        const unsigned char *row = image.ptr<unsigned char>(roi.y + r) + roi.x;
+        for (int c = 0; c < roi.width; c++)
         {
-            // this should set the real part to the desired value
-            // in the range [0,1] and the complex part to 0
-            src(r, c) = static_cast<double>(image.at<unsigned char>(r, c)) * (1.0/255.0);
-            inverted(r, c) = 255 - image.at<unsigned char>(r, c);
+            inverted(r, c) = 255 - row[c];
+            if (row[c] != 255) inkPixels++;
         }
     }
 
-    cv::Mat_<int> integral;
+    cv::Mat_<int> &integral = workspace._integral;
     cv::integral(inverted, integral, CV_32S);
 
-    // just a sanity check that the complex part
-    // is correctly default initialized to 0
-    assert(src(0,0).imag() == 0);
+    const bool spatial = _responseEngine == "spatial"
+            || (_responseEngine == "auto"
+                && spatial_is_cheaper(inkPixels, filterBank->spatialRadius(), filterSize, _numOrients));
 
-    // filter scaled input image by directional filter bank
-    // transform source to frequency domain
-    cv::Mat_<std::complex<double> > src_ft(_filterSize);
-    cv::dft(src, src_ft);
+    // spatial engine: list of the ink pixels and their amount of ink in [0,1]
+    std::vector<cv::Point> &inkPositions = workspace._inkPositions;
+    std::vector<double> &inkWeights = workspace._inkWeights;
+    double inkSum = 0;
 
-    // apply each filter
-    std::vector<cv::Mat> responses;
-    for (uint i = 0; i < _numOrients; i++) {
-        // convolve in frequency domain (i.e. multiply spectrums)
-        cv::Mat_<std::complex<double> > dst_ft(_filterSize);
-
-        // it remains unclear what the 4th parameter stands for
-        // OpenCV 2.8 doc: "The same flags as passed to dft() ; only the flag DFT_ROWS is checked for"
-        cv::mulSpectrums(src_ft, _gaborFilter[i], dst_ft, 0);
-
-        // transform back to spatial domain
-        cv::Mat_<std::complex<double> > dst;
-        cv::dft(dst_ft, dst, cv::DFT_INVERSE | cv::DFT_SCALE);
-
-        // compute magnitude of response
-        cv::Mat mag(image.size(), CV_32FC1);
-        for (int r = 0; r < mag.rows; r++) {
-            for (int c = 0; c < mag.cols; c++) {
-                const std::complex<double>& v = dst(r, c);
-                float m = std::sqrt(v.real() * v.real() + v.imag() * v.imag());
-                mag.at<float>(r, c) = m;
-#ifdef __DEBUG__
-                mag.at<float>(r, c) = 1.0-m;
-#endif //__DEBUG__
+    // frequency engine: transform of the image
+    cv::Mat_<std::complex<double> > &src_ft = workspace._srcFt;
+
+    if (spatial)
+    {
+        inkPositions.clear();
+        inkWeights.clear();
+        for (int r = 0; r < roi.height; r++) {
+            for (int c = 0; c < roi.width; c++) {
+                if (inverted(r, c) == 0) continue;
+                double w = inverted(r, c) * (1.0/255.0);
+                inkPositions.push_back(cv::Point(c, r));
+                inkWeights.push_back(w);
+                inkSum += w;
             }
         }
-#ifdef __DEBUG__
-        char filename[64];
-        sprintf(filename, "reponse_%d.png", i);
-        cv::imwrite(filename, mag*255);
-#endif //__DEBUG__
-
-        responses.push_back(mag);
     }
+    else
+    {
+        // filter the ink instead of the image: the image is 1 - ink, and as
+        // the filters have no DC component, both give the same response up to
+        // the sign. The ink is zero below the region, which lets dft skip
+        // those rows.
+        cv::Mat_<std::complex<double> > &src = workspace._src;
+        src.create(filterSize.height, filterSize.width);
+        src.setTo(cv::Scalar(0.0));
+        for (int r = 0; r < roi.height; r++) {
+            const unsigned char *row = inverted[r];
+            std::complex<double> *s = src[r];
+            for (int c = 0; c < roi.width; c++)
+            {
+                // this should set the real part to the desired value
+                // in the range [0,1] and the complex part to 0
+                s[c] = static_cast<double>(row[c]) * (1.0/255.0);
+            }
+        }
 
-    // local region size is relative to image size
-    int featureSize = std::sqrt(image.size().area() * _featureSize);
+        // just a sanity check that the complex part
+        // is correctly default initialized to 0
+        assert(src(0,0).imag() == 0);
 
-    // if not multiple of _tiles then round up
-    if (featureSize % _tiles)
-    {
-        featureSize += _tiles - (featureSize % _tiles);
+        // filter scaled input image by directional filter bank
+        // transform source to frequency domain
+        cv::dft(src, src_ft, 0, roi.height);
     }
 
-    int tileSize = featureSize / _tiles;
-    float halfTileSize = (float) tileSize / 2;
-
+    // apply each filter
+    std::vector<cv::Mat> &responses = workspace._responses;
+    responses.resize(_numOrients);
+
+    const bool sampleBoxes = _isSmoothHist && _smoothHist == "boxes";
+    int boxRadii[3];
+    double boxWeights[3];
+    if (sampleBoxes) {
+        workspace._responseIntegrals.resize(_numOrients);
+        fit_box_kernel(tileSize, tileSize / 3.0, boxRadii, boxWeights);
+    }
     for (uint i = 0; i < _numOrients; i++) {
-        // copy response image centered into a new, larger image that contains an empty border
+        SSE_TRACE_SWITCH(TraceFilter);
+        cv::Mat_<std::complex<double> > &dst = workspace._dst;
+
+        if (spatial)
+        {
+            // the frequency domain filters have no DC component, the spatial kernels
+            // do. Removing it from the response to the ink gives the response of
+            // the frequency domain engine
+            double dc = filterBank->dcGain(i) * inkSum / filterSize.area();
+            dst.create(roi.height, roi.width);
+            dst.setTo(cv::Scalar(-dc));
+            convolve_ink(inkPositions, inkWeights, filterBank->spatialFilter(i), filterBank->spatialRadius(), dst);
+        }
+        else
+        {
+            // convolve in frequency domain (i.e. multiply spectrums)
+            cv::Mat_<std::complex<double> > &dst_ft = workspace._dstFt;
+
+            // it remains unclear what the 4th parameter stands for
+            // OpenCV 2.8 doc: "The same flags as passed to dft() ; only the flag DFT_ROWS is checked for"
+            cv::mulSpectrums(src_ft, filterBank->filter(i), dst_ft, 0);
+
+            // transform back to spatial domain, only the rows of the region are needed
+            cv::dft(dst_ft, dst, cv::DFT_INVERSE | cv::DFT_SCALE, roi.height);
+        }
+
+        // write the magnitude of the response centered into a larger image that contains an empty border
         // of size tileSize around all sides. This additional  border is essential to be able to
         // later compute values outside of the original image bounds
-        cv::Mat framed = cv::Mat::zeros(image.rows + 2*tileSize, image.cols + 2*tileSize, CV_32FC1);
-        cv::Mat image_rect_in_frame = framed(cv::Rect(tileSize, tileSize, image.cols, image.rows));
-        responses[i].copyTo(image_rect_in_frame);
+        cv::Mat &framed = responses[i];
+        framed.create(roi.height + 2*tileSize, roi.width + 2*tileSize, CV_32FC1);
+        zero_frame(framed, tileSize);
+        for (int r = 0; r < roi.height; r++) {
+            // complex numbers are stored as (real, imaginary) pairs
+            const double *v = reinterpret_cast<const double*>(dst[r]);
+            float *m = framed.ptr<float>(r + tileSize) + tileSize;
+            for (int c = 0; c < roi.width; c++) {
+                m[c] = std::sqrt(v[2*c] * v[2*c] + v[2*c+1] * v[2*c+1]);
+            }
+        }
+#ifdef __DEBUG__
+        char filename[64];
+        sprintf(filename, "reponse_%d.png", i);
+        cv::Mat image_rect_in_frame = framed(cv::Rect(tileSize, tileSize, roi.width, roi.height));
+        cv::imwrite(filename, (1.0 - image_rect_in_frame)*255);
+#endif //__DEBUG__
 
-        if (_isSmoothHist)
+        SSE_TRACE_SWITCH(TraceSmooth);
+        if (_isSmoothHist && _smoothHist == "recursive")
+        {
+            recursive_gaussian_blur(framed, tileSize / 3.0);
+        }
+        else if (_isSmoothHist && _smoothHist == "boxes")
+        {
+            // not smoothed here, the keypoint loop below evaluates
+            // the smoothed value only where it is sampled
+            cv::integral(framed, workspace._responseIntegrals[i], CV_64F);
+        }
+        else if (_isSmoothHist)
         {
             int kernelSize = 2 * tileSize + 1;
             float gaussBlurSigma = tileSize / 3.0;
@@ -301,26 +590,31 @@ void Galif::extract(const cv::Mat &image, const KeyPoints_t &keypoints, Features
         }
 
         // response have now size of image + 2*tileSize in each dimension
-        responses[i] = framed;
     }
+    SSE_TRACE_SWITCH(TraceHistogram);
 
     // will contain a 1 at each index where the underlying patch in the
     // sketch is completely empty, i.e. contains no stroke, 0 at all other
     // indices. Therefore it is essential that this vector has the same size
     // as the keypoints and features vector
-    emptyFeatures.resize(keypoints.size(), 0);
+    emptyFeatures.assign(keypoints.size(), 0);
+
+    // one histogram per keypoint, all zero to start with
+    const uint histogramSize = _tiles * _tiles * _numOrients;
+    features.create(keypoints.size(), histogramSize);
+    std::fill(features.data(), features.data() + features.size() * histogramSize, 0.0f);
 
     // collect filter responses for each keypoint/region
     for (uint i = 0; i < keypoints.size(); i++) {
-        const Vec_f32_t& keypoint = keypoints[i];
+        const float *keypoint = keypoints.row(i);
 
         // create histogram: row <-> tile, column <-> histogram of directional responses
-        Vec_f32_t histogram(_tiles * _tiles * _numOrients, 0.0f);
+        float *histogram = features.row(i);
 
-        // define region
-        cv::Rect rect(keypoint[0] - featureSize/2, keypoint[1] - featureSize/2, featureSize, featureSize);
+        // define region, relative to the filtered region of the image
+        cv::Rect rect(keypoint[0] - roi.x - featureSize/2, keypoint[1] - roi.y - featureSize/2, featureSize, featureSize);
 
-        cv::Rect isec = rect & cv::Rect(0, 0, src.cols, src.rows);
+        cv::Rect isec = rect & cv::Rect(0, 0, inverted.cols, inverted.rows);
 
         // adjust rect position by frame width
         rect.x += tileSize;
@@ -335,16 +629,12 @@ void Galif::extract(const cv::Mat &image, const KeyPoints_t &keypoints, Features
         if (patchsum == 0)
         {
             // skip this patch. It contains no strokes.
-            // add empty histogram, filled with zeros,
+            // keep the empty histogram, filled with zeros,
             // will be (optionally) filtered in a later descriptor computation step
-            features.push_back(histogram);
             emptyFeatures[i] = 1;
             continue;
         }
 
-        const int ndims[3] = { (int)_tiles, (int)_tiles, (int)_numOrients };
-        cv::Mat_<float> hist(3, ndims, 0.0f);
-
         for (uint k = 0; k < responses.size(); k++) {
             for (int y = rect.y + halfTileSize; y < rect.br().y; y += tileSize) {
                 for (int x = rect.x + halfTileSize; x < rect.br().x; x += tileSize) {
@@ -366,39 +656,64 @@ void Galif::extract(const cv::Mat &image, const KeyPoints_t &keypoints, Features
                     assert(tx >= 0 && ty >= 0);
                     assert(static_cast<uint>(tx) < _tiles && static_cast<uint>(ty)  < _tiles);
 
-                    hist(ty, tx, k) = responses[k].at<float>(y, x);
+                    // histogram layout: [ty][tx][k]
+                    float &bin = histogram[(ty * _tiles + tx) * _numOrients + k];
+                    if (sampleBoxes) {
+                        const cv::Mat_<double> &integral = workspace._responseIntegrals[k];
+                        bin = boxWeights[0] * box_sum(integral, y, x, boxRadii[0])
+                            + boxWeights[1] * box_sum(integral, y, x, boxRadii[1])
+                            + boxWeights[2] * box_sum(integral, y, x, boxRadii[2]);
+                    }
+                    else {
+                        bin = responses[k].at<float>(y, x);
+                    }
                 }
             }
         }
 
-        std::copy(hist.begin(), hist.end(), histogram.begin());
+        normalizeHistogram(histogram);
+    }
+}
 
-        if (_normalizeHist == "l2")
-        {
-            float sum = 0;
-            for (size_t i = 0; i < histogram.size(); i++) sum += histogram[i]*histogram[i];
-            sum = std::sqrt(sum)  + std::numeric_limits<float>::epsilon(); // + eps avoids div by zero
-            for (size_t i = 0; i < histogram.size(); i++) histogram[i] /= sum;
-        }
-        else if (_normalizeHist == "lowe")
-        {
-            cv::Mat histwrap(histogram);
-            cv::Mat tmp;
-            cv::normalize(histwrap, tmp, 1, 0, cv::NORM_L1);
-            tmp = cv::min(tmp, 0.2);
-            cv::normalize(histwrap, histwrap, 1, 0, cv::NORM_L1);
-            histogram = histwrap;
-        }
+int Galif::patchSize(const cv::Size &imageSize) const
+{
+    // local region size is relative to image size
+    int featureSize = std::sqrt(imageSize.area() * _featureSize);
 
-        // do not normalize if user has explicitly asked for that
-        else if (_normalizeHist == "none") {}
+    // if not multiple of _tiles then round up
+    if (featureSize % _tiles)
+    {
+        featureSize += _tiles - (featureSize % _tiles);
+    }
+    return featureSize;
+}
 
-        // let the user know about the wrong parameter
-        else throw std::runtime_error("unsupported histogram normalization method passed (" + _normalizeHist + ")." + "Allowed methods are : lowe, l2, none." );
+void Galif::normalizeHistogram(float *histogram) const
+{
+    const uint histogramSize = _tiles * _tiles * _numOrients;
 
-        // add histogram to the set of local features for that image
-        features.push_back(histogram);
+    if (_normalizeHist == "l2")
+    {
+        float sum = 0;
+        for (size_t i = 0; i < histogramSize; i++) sum += histogram[i]*histogram[i];
+        sum = std::sqrt(sum)  + std::numeric_limits<float>::epsilon(); // + eps avoids div by zero
+        for (size_t i = 0; i < histogramSize; i++) histogram[i] /= sum;
+    }
+    else if (_normalizeHist == "lowe")
+    {
+        // L1 normalization in place, like cv::normalize(.., NORM_L1) did without a temporary matrix.
+        // The clamped copy computed before was never used, so the clamping is left out here as well
+        double sum = 0;
+        for (size_t i = 0; i < histogramSize; i++) sum += std::fabs(histogram[i]);
+        double scale = sum > std::numeric_limits<double>::epsilon() ? 1 / sum : 0;
+        for (size_t i = 0; i < histogramSize; i++) histogram[i] *= scale;
     }
+
+    // do not normalize if user has explicitly asked for that
+    else if (_normalizeHist == "none") {}
+
+    // let the user know about the wrong parameter
+    else throw std::runtime_error("unsupported histogram normalization method passed (" + _normalizeHist + ")." + "Allowed methods are : lowe, l2, none." );
 }
 
 void Galif::assertImageSize(const cv::Mat &image) const
@@ -407,6 +722,234 @@ void Galif::assertImageSize(const cv::Mat &image) const
     assert((image.size().width <= _filterSize.height) && (image.size().height <= _filterSize.width));
 }
 
-} //namespace sse
+static void report_all(size_t numSamples, std::vector<uint> &changed)
+{
+    changed.resize(numSamples);
+    for (size_t i = 0; i < numSamples; i++) changed[i] = i;
+}
 
+IncrementalGalif::IncrementalGalif(const Galif &galif)
+    : _galif(galif), _patchSize(0), _tileSize(0), _inkSum(0)
+{
+    if (_galif._cropToStrokes || _galif._detectorName == "stroke-adaptive"
+            || (_galif._isSmoothHist && _galif._smoothHist != "gaussian"))
+        throw std::runtime_error("incremental features need the grid or stroke detector, gaussian or no smoothing and no cropToStrokes.");
+}
+
+void IncrementalGalif::reset()
+{
+    _previous = cv::Mat();
+}
+
+void IncrementalGalif::initialize(const cv::Size &size)
+{
+    _previous.create(size, CV_8UC1);
+    _previous.setTo(cv::Scalar(255));
+
+    _patchSize = _galif.patchSize(size);
+    _tileSize = _patchSize / _galif._tiles;
+
+    const uint numOrients = _galif._numOrients;
+    _convolved.resize(numOrients);
+    _magnitudes.resize(numOrients);
+    _responses.resize(numOrients);
+    for (uint i = 0; i < numOrients; i++) {
+        _convolved[i].create(size.height, size.width);
+        _convolved[i].setTo(cv::Scalar(0.0));
+        _magnitudes[i].create(size.height + 2*_tileSize, size.width + 2*_tileSize, CV_32FC1);
+        _magnitudes[i].setTo(cv::Scalar(0));
+        _responses[i].create(size.height + 2*_tileSize, size.width + 2*_tileSize, CV_32FC1);
+        _responses[i].setTo(cv::Scalar(0));
+    }
+    _inkSum = 0;
 
+    // every sample of the grid, the stroke detector only drops the empty ones
+    _keypoints.clear();
+    GridDetector(_galif._numOfSamples).detect(_previous, _keypoints);
+    normalizeKeypoints(_keypoints, size, _keypointsNormalized);
+
+    const uint histogramSize = _galif._tiles * _galif._tiles * numOrients;
+    _features.create(_keypoints.size(), histogramSize);
+    std::fill(_features.data(), _features.data() + _features.size() * histogramSize, 0.0f);
+    _empty.assign(_keypoints.size(), 1);
+}
+
+void IncrementalGalif::refilter()
+{
+    const GaborFilterBank &filterBank = *_galif._filterBank;
+    const cv::Size &filterSize = filterBank.filterSize();
+
+    _src.create(filterSize.height, filterSize.width);
+    _src.setTo(cv::Scalar(0.0));
+    _inkSum = 0;
+    for (int r = 0; r < _previous.rows; r++) {
+        const unsigned char *row = _previous.ptr<unsigned char>(r);
+        for (int c = 0; c < _previous.cols; c++) {
+            double ink = (255 - row[c]) * (1.0/255.0);
+            _src(r, c) = ink;
+            _inkSum += ink;
+        }
+    }
+    cv::dft(_src, _srcFt, 0, _previous.rows);
+
+    for (uint i = 0; i < _galif._numOrients; i++) {
+        cv::mulSpectrums(_srcFt, filterBank.filter(i), _dstFt, 0);
+        cv::dft(_dstFt, _dst, cv::DFT_INVERSE | cv::DFT_SCALE, _previous.rows);
+
+        // the frequency domain filters have no DC component, add it back
+        // to get the plain convolution with the spatial kernel
+        double dc = filterBank.dcGain(i) * _inkSum / filterSize.area();
+        for (int r = 0; r < _previous.rows; r++) {
+            for (int c = 0; c < _previous.cols; c++) {
+                _convolved[i](r, c) = _dst(r, c) + dc;
+            }
+        }
+    }
+}
+
+void IncrementalGalif::compute(const cv::Mat &image, std::vector<uint> &changed)
+{
+    changed.clear();
+
+    _galif.scaleGray(image, _gray, _scaled);
+    _galif.assertImageSize(_scaled);
+
+    // a new grid: the samples keep their positions only if the size stays the same,
+    // so all of them are reported, not only those around the ink
+    const bool initialized = _scaled.size() != _previous.size();
+    if (initialized)
+        initialize(_scaled.size());
+
+    // the pixels that changed since the previous image, weighted by the change of their amount of ink
+    _inkPositions.clear();
+    _inkWeights.clear();
+    int top = _scaled.rows, bottom = -1, left = _scaled.cols, right = -1;
+    double inkChange = 0;
+    for (int r = 0; r < _scaled.rows; r++) {
+        const unsigned char *now = _scaled.ptr<unsigned char>(r);
+        const unsigned char *before = _previous.ptr<unsigned char>(r);
+        for (int c = 0; c < _scaled.cols; c++) {
+            if (now[c] == before[c]) continue;
+            double w = (before[c] - now[c]) * (1.0/255.0);
+            _inkPositions.push_back(cv::Point(c, r));
+            _inkWeights.push_back(w);
+            inkChange += w;
+            top = std::min(top, r);
+            bottom = r;
+            left = std::min(left, c);
+            right = std::max(right, c);
+        }
+    }
+    if (bottom < 0) {
+        if (initialized) report_all(_keypoints.size(), changed);
+        return;
+    }
+
+    const cv::Rect dirty(left, top, right - left + 1, bottom - top + 1);
+    const cv::Rect imageRect(0, 0, _scaled.cols, _scaled.rows);
+    _scaled.copyTo(_previous);
+    cv::integral(_previous, _integral, CV_32S);
+
+    const GaborFilterBank &filterBank = *_galif._filterBank;
+    const int radius = filterBank.spatialRadius();
+    const uint numOrients = _galif._numOrients;
+
+    // region of the responses that changed
+    cv::Rect filtered;
+    if (spatial_is_cheaper(_inkPositions.size(), radius, filterBank.filterSize(), numOrients))
+    {
+        // the convolution is linear, adding that of the change updates it
+        for (uint i = 0; i < numOrients; i++) {
+            convolve_ink(_inkPositions, _inkWeights, filterBank.spatialFilter(i), radius, _convolved[i]);
+        }
+        _inkSum += inkChange;
+        filtered = cv::Rect(dirty.x - radius, dirty.y - radius, dirty.width + 2*radius, dirty.height + 2*radius) & imageRect;
+    }
+    else
+    {
+        refilter();
+        filtered = imageRect;
+    }
+
+    const int tileSize = _tileSize;
+    for (uint i = 0; i < numOrients; i++) {
+        double dc = filterBank.dcGain(i) * _inkSum / filterBank.filterSize().area();
+        for (int r = filtered.y; r < filtered.br().y; r++) {
+            const std::complex<double> *v = _convolved[i][r];
+            float *m = _magnitudes[i].ptr<float>(r + tileSize) + tileSize;
+            for (int c = filtered.x; c < filtered.br().x; c++) {
+                double re = v[c].real() - dc, im = v[c].imag();
+                m[c] = std::sqrt(re * re + im * im);
+            }
+        }
+    }
+
+    // region of the framed responses that changed, the smoothing reaches one tile further,
+    // which cancels with the frame
+    const cv::Rect framedRect(0, 0, _scaled.cols + 2*tileSize, _scaled.rows + 2*tileSize);
+    const cv::Rect smoothed = cv::Rect(filtered.x, filtered.y, filtered.width + 2*tileSize, filtered.height + 2*tileSize) & framedRect;
+    for (uint i = 0; i < numOrients; i++) {
+        // filters read the pixels around a submatrix as its border, so smoothing only
+        // the region gives the same values there as smoothing the whole response
+        cv::Mat region = _magnitudes[i](smoothed);
+        if (_galif._isSmoothHist)
+        {
+            int kernelSize = 2 * tileSize + 1;
+            float gaussBlurSigma = tileSize / 3.0;
+            cv::GaussianBlur(region, _smoothed, cv::Size(kernelSize, kernelSize), gaussBlurSigma, gaussBlurSigma);
+        }
+        else
+        {
+            cv::boxFilter(region, _smoothed, CV_32F, cv::Size(tileSize, tileSize), cv::Point(-1, -1), false);
+        }
+        cv::Mat target = _responses[i](smoothed);
+        _smoothed.copyTo(target);
+    }
+
+    // recompute the histograms of the samples whose patch contains a change
+    // or samples a changed response, see Galif::extract
+    const int featureSize = _patchSize;
+    const float halfTileSize = (float) tileSize / 2;
+    const uint tiles = _galif._tiles;
+    const uint histogramSize = tiles * tiles * numOrients;
+    for (uint i = 0; i < _keypoints.size(); i++) {
+        const float *keypoint = _keypoints.row(i);
+
+        cv::Rect rect(keypoint[0] - featureSize/2, keypoint[1] - featureSize/2, featureSize, featureSize);
+        cv::Rect framed(rect.x + tileSize, rect.y + tileSize, featureSize, featureSize);
+        if ((rect & dirty).area() == 0 && (framed & smoothed).area() == 0) continue;
+        changed.push_back(i);
+
+        float *histogram = _features.row(i);
+        std::fill(histogram, histogram + histogramSize, 0.0f);
+
+        cv::Rect isec = rect & imageRect;
+        int patchsum = _integral(isec.tl())
+                + _integral(isec.br())
+                - _integral(isec.y, isec.x + isec.width)
+                - _integral(isec.y + isec.height, isec.x);
+        _empty[i] = patchsum == 255 * isec.area();
+        if (_empty[i]) continue;
+
+        for (uint k = 0; k < numOrients; k++) {
+            for (int y = framed.y + halfTileSize; y < framed.br().y; y += tileSize) {
+                for (int x = framed.x + halfTileSize; x < framed.br().x; x += tileSize) {
+                    if (y < 0 || x < 0 || y >= _responses[k].rows || x >= _responses[k].cols)
+                    {
+                        continue;
+                    }
+
+                    int tx = (x - framed.x) / tileSize;
+                    int ty = (y - framed.y) / tileSize;
+                    histogram[(ty * tiles + tx) * numOrients + k] = _responses[k].at<float>(y, x);
+                }
+            }
+        }
+
+        _galif.normalizeHistogram(histogram);
+    }
+
+    if (initialized) report_all(_keypoints.size(), changed);
+}
+
+} //namespace sse
@@ -19,9 +19,51 @@
 
 #include "feature.h"
 #include "detector.h"
+#include "gabor.h"
 
 namespace sse {
 
+/**
+ * @brief The GalifWorkspace class
+ * Scratch buffers of Galif::compute and Galif::extract.
+ *
+ * All intermediate matrices of Galif live here and are reused from image to
+ * image, so they are only allocated again when the image size changes (or,
+ * with cropToStrokes, the size of the stroke region). The OpenCV routines
+ * working on them (cv::dft, cv::GaussianBlur, ...) still take small scratch
+ * memory of their own on every call, see checkWorkspaceReuse in bench/checks.cpp.
+ * Galif itself is stateless while computing: one instance can serve many
+ * threads, as long as each thread uses its own workspace. The overloads
+ * without a workspace use one per thread.
+ */
+class GalifWorkspace
+{
+private:
+    friend class Galif;
+
+    cv::Mat _gray;
+    cv::Mat _scaled;
+    cv::Mat _recentred;
+    cv::Mat_<std::complex<double> > _src;
+    cv::Mat_<std::complex<double> > _srcFt;
+    cv::Mat_<std::complex<double> > _dstFt;
+    cv::Mat_<std::complex<double> > _dst;
+    cv::Mat_<unsigned char> _inverted;
+    cv::Mat_<int> _integral;
+    // ink pixels of the image, for the spatial response engine
+    std::vector<cv::Point> _inkPositions;
+    std::vector<double> _inkWeights;
+    // framed, smoothed response of each orientation
+    std::vector<cv::Mat> _responses;
+    // integral images of the responses, for smoothHist "boxes"
+    std::vector<cv::Mat_<double> > _responseIntegrals;
+    // keypoints and features before empty ones are filtered
+    KeyPoints_t _keypoints;
+    KeyPoints_t _keypointsNormalized;
+    Features_t _features;
+    Vec_Index_t _emptyFeatures;
+};
+
 class Galif : public Feature
 {
 public:
@@ -32,14 +74,33 @@ public:
           double featureSize = 0.1,
           bool isSmoothHist = true,
           const std::string& normalizeHist = "l2",
-          const std::string& detectorName = "grid",
-          uint numOfSamples = 625);
+          const std::string& detectorName = "stroke",
+          uint numOfSamples = 625,
+          const std::string& smoothHist = "gaussian",
+          bool cropToStrokes = false,
+          const std::string& responseEngine = "fft");
     void compute(const cv::Mat &image, KeyPoints_t &keypoints, Features_t &features) const;
+    void compute(const cv::Mat &image, KeyPoints_t &keypoints, Features_t &features, GalifWorkspace &workspace) const;
     double scale(const cv::Mat &image, cv::Mat &scaled) const;
+    // longest image side the features are computed at
+    uint width() const { return _width; }
+    // number of values of one feature
+    uint featureLength() const { return _tiles * _tiles * _numOrients; }
     void detect(const cv::Mat &image, KeyPoints_t &keypoints) const;
     void extract(const cv::Mat &image, const KeyPoints_t &keypoints, Features_t &features, Vec_Index_t &emptyFeatures) const;
+    void extract(const cv::Mat &image, const KeyPoints_t &keypoints, Features_t &features, Vec_Index_t &emptyFeatures,
+                 GalifWorkspace &workspace) const;
 private:
+    friend class IncrementalGalif;
+
     void assertImageSize(const cv::Mat &image) const;
+    // scaled gray version of an 8 bit gray (or binary) or 3 channel image,
+    // gray receives the conversion of a 3 channel image
+    void scaleGray(const cv::Mat &image, cv::Mat &gray, cv::Mat &scaled) const;
+    // side length of the (square) patch of a feature, a multiple of _tiles
+    int patchSize(const cv::Size &imageSize) const;
+    // normalizes one histogram in place according to _normalizeHist
+    void normalizeHistogram(float *histogram) const;
 
     const uint _width;
     const uint _numOrients;
@@ -51,12 +112,105 @@ private:
     const bool _isSmoothHist;
     const std::string _normalizeHist;
     const std::string _detectorName;
+    // gaussian smoothing of the responses (if _isSmoothHist):
+    // "gaussian" exact gaussian blur of the whole response
+    // "recursive" recursive gaussian, cost independent of the tile size
+    // "boxes" sum of three boxes, only evaluated at the sampled positions
+    const std::string _smoothHist;
+    // filter only the region around the strokes, which are moved to the
+    // image center first, this makes the descriptors translation invariant
+    const bool _cropToStrokes;
+    // how the filter responses are computed:
+    // "fft" multiplication in the frequency domain (the default)
+    // "spatial" convolution of the ink pixels with the spatial kernels, cheaper for sparse sketches and small filters
+    // "auto" whichever is cheaper for the image at hand
+    // The spatial kernels are truncated, their descriptors differ slightly from
+    // those of "fft": index and query with the same engine.
+    const std::string _responseEngine;
+    const uint _numOfSamples;
 
     cv::Size _filterSize;
-    std::vector<cv::Mat_<std::complex<double> > > _gaborFilter;
+    std::shared_ptr<const GaborFilterBank> _filterBank;
     Detector *_detector;
 };
 
+/**
+ * @brief Galif features of a sketch that changes a little at a time
+ *
+ * Keeps the filter responses of the previous image. compute() only filters
+ * the pixels that changed since then (with the spatial kernels, or with the
+ * FFT if that is cheaper) and only recomputes the histograms of the grid
+ * samples whose patch can see the change, so the cost of an update depends
+ * on the size of the change rather than on the size of the sketch.
+ *
+ * The features equal those of Galif::compute with the spatial engine, up to
+ * the DC correction of the responses (see GaborFilterBank::dcGain), which is
+ * only updated inside the changed region. It is proportional to the total
+ * amount of ink over the image area, i.e. tiny. Supports the grid and stroke
+ * detectors and gaussian or no histogram smoothing without cropToStrokes,
+ * the constructor throws std::runtime_error for other configurations.
+ *
+ * Holds a reference to galif. Not thread safe, use one instance per sketch.
+ */
+class IncrementalGalif
+{
+public:
+    IncrementalGalif(const Galif &galif);
+
+    // Forgets the previous image, the next compute() starts from an empty canvas
+    void reset();
+
+    // image as for Galif::compute. Afterwards keypoints() and features() hold
+    // every grid sample, empty ones included (see isEmpty()). changed receives
+    // the indices of the samples whose feature may have changed, all of them
+    // when the grid was laid out again (first image, new size or after reset())
+    void compute(const cv::Mat &image, std::vector<uint> &changed);
+
+    // normalized to [0,1]x[0,1] like those of Galif::compute
+    const KeyPoints_t& keypoints() const { return _keypointsNormalized; }
+    const Features_t& features() const { return _features; }
+    bool isEmpty(uint i) const { return _empty[i] != 0; }
+    // size of the scaled image the features were computed at
+    cv::Size size() const { return _previous.size(); }
+
+private:
+    void initialize(const cv::Size &size);
+    // recomputes the response of every orientation from the ink with the FFT
+    void refilter();
+
+    const Galif &_galif;
+
+    cv::Mat _gray;
+    cv::Mat _scaled;
+    // the previous scaled image, white before the first compute()
+    cv::Mat _previous;
+    cv::Mat_<int> _integral;
+    int _patchSize;
+    int _tileSize;
+
+    // per orientation: the ink convolved with the spatial kernel, without
+    // the DC correction, as well as the framed magnitudes of the corrected
+    // responses before and after smoothing (see Galif::extract)
+    std::vector<cv::Mat_<std::complex<double> > > _convolved;
+    std::vector<cv::Mat> _magnitudes;
+    std::vector<cv::Mat> _responses;
+    double _inkSum;
+
+    KeyPoints_t _keypoints;
+    KeyPoints_t _keypointsNormalized;
+    Features_t _features;
+    std::vector<char> _empty;
+
+    // scratch buffers
+    std::vector<cv::Point> _inkPositions;
+    std::vector<double> _inkWeights;
+    cv::Mat_<std::complex<double> > _src;
+    cv::Mat_<std::complex<double> > _srcFt;
+    cv::Mat_<std::complex<double> > _dstFt;
+    cv::Mat_<std::complex<double> > _dst;
+    cv::Mat _smoothed;
+};
+
 } //namespace sse
 
 #endif // GALIF_H
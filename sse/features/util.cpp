@@ -21,11 +21,11 @@ namespace sse {
 
 void normalizeKeypoints(const KeyPoints_t &keypoints, const cv::Size &imageSize, KeyPoints_t &keypointsNormalized)
 {
-    Vec_f32_t p(2);
+    keypointsNormalized.create(keypoints.size(), 2);
     for (size_t i = 0; i < keypoints.size(); i++) {
+        float *p = keypointsNormalized.row(i);
         p[0] = keypoints[i][0] / imageSize.width;
         p[1] = keypoints[i][1] / imageSize.height;
-        keypointsNormalized.push_back(p);
     }
 }
 
@@ -35,6 +35,11 @@ void filterEmptyFeatures(const Features_t &features, const KeyPoints_t &keypoint
     assert(features.size() == keypoints.size());
     assert(features.size() == emptyFeatures.size());
 
+    featuresFiltered.create(0, features.cols());
+    keypointsFiltered.create(0, keypoints.cols());
+    featuresFiltered.reserve(features.size());
+    keypointsFiltered.reserve(keypoints.size());
+
     for (size_t i = 0; i < emptyFeatures.size(); i++) {
 
         if (!emptyFeatures[i]) {
@@ -44,4 +49,55 @@ void filterEmptyFeatures(const Features_t &features, const KeyPoints_t &keypoint
     }
 }
 
+cv::Rect strokeBoundingBox(const cv::Mat &image)
+{
+    assert(image.type() == CV_8UC1);
+
+    int top = image.rows, bottom = -1, left = image.cols, right = -1;
+    for (int r = 0; r < image.rows; r++) {
+        const unsigned char *row = image.ptr<unsigned char>(r);
+        for (int c = 0; c < image.cols; c++) {
+            if (row[c] == 255) continue;
+            top = std::min(top, r);
+            bottom = r;
+            left = std::min(left, c);
+            right = std::max(right, c);
+        }
+    }
+
+    if (bottom < 0) return cv::Rect();
+    return cv::Rect(left, top, right - left + 1, bottom - top + 1);
+}
+
+static int round_int(double v)
+{
+    return static_cast<int>(std::lround(v));
+}
+
+void rasterizeStrokes(const Strokes_t &strokes, const cv::Size &canvasSize, float penWidth, uint width, cv::Mat &image)
+{
+    assert(canvasSize.width > 0 && canvasSize.height > 0);
+
+    const double scaling = static_cast<double>(width) / std::max(canvasSize.width, canvasSize.height);
+    image.create(std::max(1, round_int(canvasSize.height * scaling)), std::max(1, round_int(canvasSize.width * scaling)), CV_8UC1);
+    image.setTo(cv::Scalar(255));
+
+    // draw at sub pixel positions, the scaled down strokes would be jagged otherwise
+    const int shift = 4;
+    const double fixed = scaling * (1 << shift);
+    const int thickness = std::max(1, round_int(penWidth * scaling));
+
+    for (size_t s = 0; s < strokes.size(); s++) {
+        const Stroke_t &stroke = strokes[s];
+        // a single point is drawn as a dot
+        for (size_t i = stroke.size() > 1 ? 1 : 0; i < stroke.size(); i++) {
+            const cv::Point2f &from = stroke[i > 0 ? i - 1 : 0];
+            const cv::Point2f &to = stroke[i];
+            cv::line(image, cv::Point(round_int(from.x * fixed), round_int(from.y * fixed)),
+                     cv::Point(round_int(to.x * fixed), round_int(to.y * fixed)),
+                     cv::Scalar(0), thickness, cv::LINE_AA, shift);
+        }
+    }
+}
+
 } //namespace sse
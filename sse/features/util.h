@@ -22,12 +22,20 @@
 namespace sse {
 
 // Normalizes keypoint coordinates into range [0, 1] x [0, 1] to have them stored independently of image size
+// Both functions replace the content of their output parameters
 void normalizeKeypoints(const KeyPoints_t &keypoints, const cv::Size &imageSize, KeyPoints_t &keypointsNormalized);
 
 // Removes all empty features, i.e. those that only contains zeros
 void filterEmptyFeatures(const Features_t &features, const KeyPoints_t &keypoints, const vector<Index_t> &emptyFeatures,
                          Features_t &featuresFiltered, KeyPoints_t &keypointsFiltered);
 
+// Bounding box of the strokes (all non white pixels) of a CV_8UC1 sketch, empty if there are none
+cv::Rect strokeBoundingBox(const cv::Mat &image);
+
+// Draws the strokes of a canvas of canvasSize black on white, uniformly scaled such that the longer
+// canvas side becomes width pixels. penWidth is given in canvas pixels. The result is CV_8UC1.
+void rasterizeStrokes(const Strokes_t &strokes, const cv::Size &canvasSize, float penWidth, uint width, cv::Mat &image);
+
 } //namespace sse
 
 #endif // UTIL_H
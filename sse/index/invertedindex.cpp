@@ -15,6 +15,7 @@
  * limitations under the License.
 **************************************************************************/
 #include "invertedindex.h"
+#include "../common/trace.h"
 
 #include <queue>
 #include <stack>
@@ -60,7 +61,31 @@ void InvertedIndex::addSample(const Vec_f32_t &sample)
     _numOfDocuments ++;
 }
 
+void InvertedIndex::addSample(const SparseHist_t &sample)
+{
+    for(uint i = 0; i < sample.size(); i++) {
+       uint t = sample[i].first;
+       float f_dt = sample[i].second;
+       assert(t < _numOfWords);
+       assert(i == 0 || sample[i-1].first < t);
+       if(f_dt > 0) {
+            _ft[t]++;
+            _invertedList[t].push_back(std::make_pair(_numOfDocuments, f_dt));
+
+            _uniqueTerms.insert(t);
+       }
+    }
+
+    _numOfDocuments ++;
+}
+
 void InvertedIndex::createIndex(const TF_interface &tf, const IDF_interface &idf)
+{
+    SSE_TRACE_SCOPE(TraceCreateIndex);
+    weigh(tf, idf);
+}
+
+void InvertedIndex::weigh(const TF_interface &tf, const IDF_interface &idf)
 {
     assert(_weightList.size() == _invertedList.size());
 
@@ -102,8 +127,9 @@ void InvertedIndex::createIndex(const TF_interface &tf, const IDF_interface &idf
 }
 
 void InvertedIndex::query(const Vec_f32_t &sample, const TF_interface &tf, const IDF_interface &idf,
-                          uint numOfResults, std::vector<ResultItem_t> &results)
+                          uint numOfResults, std::vector<ResultItem_t> &results) const
 {
+    SSE_TRACE_SCOPE(TraceScore);
     numOfResults = std::min(numOfResults, _numOfDocuments);
 
     results.clear();
@@ -112,7 +138,7 @@ void InvertedIndex::query(const Vec_f32_t &sample, const TF_interface &tf, const
     // get query tf-idf weight
     InvertedIndex indexSample(_numOfWords);
     indexSample.addSample(sample);
-    indexSample.createIndex(tf, idf);
+    indexSample.weigh(tf, idf);
 
     // accumulators A
     std::vector<float> A(_numOfDocuments, 0);
@@ -124,6 +150,7 @@ void InvertedIndex::query(const Vec_f32_t &sample, const TF_interface &tf, const
 
         const std::vector<std::pair<uint, float> > &term_list = _invertedList[termId];
         const std::vector<float> &weight_list = _weightList[termId];
+        SSE_TRACE_COUNT(TracePostings, term_list.size());
 
         for(uint listId = 0; listId < term_list.size(); listId++) {
             uint docId = term_list[listId].first;
@@ -132,6 +159,7 @@ void InvertedIndex::query(const Vec_f32_t &sample, const TF_interface &tf, const
         }
     }
 
+    SSE_TRACE_SWITCH(TraceTopK);
     std::priority_queue<ResultItem_t, std::vector<ResultItem_t>, std::greater<ResultItem_t> > queue;
 
     for(uint i = 0; i < _numOfDocuments; i++) {
@@ -153,8 +181,9 @@ void InvertedIndex::query(const Vec_f32_t &sample, const TF_interface &tf, const
 
 //many views
 void InvertedIndex::query(const Vec_f32_t &sample, const TF_interface &tf, const IDF_interface &idf,
-                          uint numOfResults, uint numOfViews, std::vector<ResultItem_t> &results)
+                          uint numOfResults, uint numOfViews, std::vector<ResultItem_t> &results) const
 {
+    SSE_TRACE_SCOPE(TraceScore);
     uint _numOfResults = std::min(numOfResults*numOfViews, _numOfDocuments);
 
     results.clear();
@@ -163,7 +192,7 @@ void InvertedIndex::query(const Vec_f32_t &sample, const TF_interface &tf, const
     // get query tf-idf weight
     InvertedIndex indexSample(_numOfWords);
     indexSample.addSample(sample);
-    indexSample.createIndex(tf, idf);
+    indexSample.weigh(tf, idf);
 
     // accumulators A
     std::vector<float> A(_numOfDocuments, 0);
@@ -175,6 +204,7 @@ void InvertedIndex::query(const Vec_f32_t &sample, const TF_interface &tf, const
 
         const std::vector<std::pair<uint, float> > &term_list = _invertedList[termId];
         const std::vector<float> &weight_list = _weightList[termId];
+        SSE_TRACE_COUNT(TracePostings, term_list.size());
 
         for(uint listId = 0; listId < term_list.size(); listId++) {
             uint docId = term_list[listId].first;
@@ -183,6 +213,7 @@ void InvertedIndex::query(const Vec_f32_t &sample, const TF_interface &tf, const
         }
     }
 
+    SSE_TRACE_SWITCH(TraceTopK);
     std::priority_queue<ResultItem_t, std::vector<ResultItem_t>, std::greater<ResultItem_t> > queue;
 
     for(uint i = 0; i < _numOfDocuments; i++) {
@@ -27,11 +27,12 @@ class InvertedIndex
 public:
     InvertedIndex(uint vocabularySize = 0);
     void addSample(const Vec_f32_t &sample);
+    void addSample(const SparseHist_t &sample);
     void createIndex(const TF_interface &tf, const IDF_interface &idf);
     void query(const Vec_f32_t &sample, const TF_interface &tf, const IDF_interface &idf,
-               uint numOfResults, std::vector<ResultItem_t> &results);
+               uint numOfResults, std::vector<ResultItem_t> &results) const;
     void query(const Vec_f32_t &sample, const TF_interface &tf, const IDF_interface &idf,
-               uint numOfResults, uint numOfViews, std::vector<ResultItem_t> &results);
+               uint numOfResults, uint numOfViews, std::vector<ResultItem_t> &results) const;
     void save(const std::string& filename);
     void load(const std::string& filename);
 
@@ -42,6 +43,8 @@ public:
     inline uint numOfDocuments() const { return _numOfDocuments; }
 private:
     void init(uint numOfWords = 0);
+    // the work of createIndex, which only adds tracing
+    void weigh(const TF_interface &tf, const IDF_interface &idf);
 
     uint _numOfWords;
 
@@ -0,0 +1,119 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include "dataset_reader.h"
+#include "../common/trace.h"
+
+#include <fstream>
+
+namespace sse {
+
+DatasetReader::DatasetReader(const FileList &files, uint minSide, uint numThreads, uint queueSize)
+    : _files(files), _minSide(minSide), _taken(0), _stopped(false), _next(0)
+{
+    numThreads = std::max(1u, numThreads);
+    if (queueSize == 0) queueSize = 4 * numThreads;
+    _slots.resize(queueSize);
+    _slotImage.resize(queueSize);
+    for (uint s = 0; s < queueSize; s++) _slotImage[s] = s;
+    _ready.resize(queueSize, false);
+
+    for (uint t = 0; t < numThreads; t++) {
+        _decoders.push_back(std::thread(&DatasetReader::decoder, this));
+    }
+}
+
+DatasetReader::~DatasetReader()
+{
+    {
+        std::lock_guard<std::mutex> locker(_mutex);
+        _stopped = true;
+        _changed.notify_all();
+    }
+    for (size_t t = 0; t < _decoders.size(); t++) _decoders[t].join();
+}
+
+bool DatasetReader::next(uint &index, cv::Mat &image)
+{
+    std::unique_lock<std::mutex> locker(_mutex);
+    if (_taken == _files.size())
+        return false;
+
+    index = _taken++;
+    uint slot = index % _slots.size();
+    _changed.wait(locker, [&]() { return _ready[slot] && _slotImage[slot] == index; });
+    image = _slots[slot];
+    _slots[slot].release();
+    _ready[slot] = false;
+    _slotImage[slot] += _slots.size();
+    _changed.notify_all();
+    return true;
+}
+
+void DatasetReader::decoder()
+{
+    uint reduction = 0;
+    for (uint i = _next++; i < _files.size(); i = _next++) {
+        cv::Mat image = decode(_files.getFilename(i), _minSide, reduction);
+
+        // the images are taken in order, wait until image i fits into the queue
+        uint slot = i % _slots.size();
+        std::unique_lock<std::mutex> locker(_mutex);
+        _changed.wait(locker, [&]() { return _stopped || (_slotImage[slot] == i && !_ready[slot]); });
+        if (_stopped)
+            return;
+        _slots[slot] = image;
+        _ready[slot] = true;
+        _changed.notify_all();
+    }
+}
+
+// by its content, whatever the file is called
+static bool is_jpeg(const std::string &filename)
+{
+    unsigned char magic[3] = { 0, 0, 0 };
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    in.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    return in && magic[0] == 0xFF && magic[1] == 0xD8 && magic[2] == 0xFF;
+}
+
+cv::Mat DatasetReader::decode(const std::string &filename, uint minSide, uint &reduction)
+{
+    SSE_TRACE_SCOPE(TraceDecode);
+    static const int flags[] = { cv::IMREAD_GRAYSCALE, cv::IMREAD_REDUCED_GRAYSCALE_2,
+                                 cv::IMREAD_REDUCED_GRAYSCALE_4, cv::IMREAD_REDUCED_GRAYSCALE_8 };
+
+    // OpenCV decodes other formats at full size and then shrinks them without area
+    // averaging, which loses thin strokes. Those are left to Galif::scale, the guess
+    // is kept for the next JPEG
+    if (minSide == 0 || !is_jpeg(filename))
+        return cv::imread(filename, cv::IMREAD_GRAYSCALE);
+
+    cv::Mat image = cv::imread(filename, flags[reduction]);
+    while (reduction > 0 && !image.empty() && static_cast<uint>(std::max(image.cols, image.rows)) < minSide) {
+        reduction--;
+        image = cv::imread(filename, flags[reduction]);
+    }
+    if (!image.empty()) {
+        // largest reduction for an image of the same size
+        uint side = static_cast<uint>(std::max(image.cols, image.rows)) << reduction;
+        reduction = 0;
+        while (reduction < 3 && (side >> (reduction + 1)) >= minSide) reduction++;
+    }
+    return image;
+}
+
+} //namespace sse
@@ -0,0 +1,86 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#ifndef DATASET_READER_H
+#define DATASET_READER_H
+
+#include "filelist.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace sse {
+
+/**
+ * @brief Decodes the images of a FileList on a pool of threads
+ *
+ * The decoded images are handed out by next() in file order. At most
+ * queueSize of them wait to be taken, the decoders block when the queue is
+ * full, so memory stays bounded no matter how slow the consumer is.
+ *
+ * Images are decoded straight to grayscale. If minSide > 0, JPEGs (as told
+ * by their first bytes) are decoded at 1/2, 1/4 or 1/8 of their size by the
+ * JPEG decoder itself, the largest reduction that keeps the longer side at
+ * least minSide (e.g. Galif::width(), as Galif scales the image to that size
+ * anyway). Each decoder guesses the reduction from the size of its previous
+ * JPEG and decodes again at a larger size if the guess was too small. Other
+ * formats are decoded at full size and left to Galif::scale.
+ *
+ * next() may be called from several threads. The destructor stops the
+ * decoders, even if not all images were taken.
+ */
+class DatasetReader
+{
+public:
+    // queueSize 0: 4 images per decoder
+    DatasetReader(const FileList &files, uint minSide = 0, uint numThreads = 1, uint queueSize = 0);
+    ~DatasetReader();
+
+    // Waits for the next image in file order. image is empty if the file
+    // could not be read. Returns false once every image was handed out
+    bool next(uint &index, cv::Mat &image);
+
+    // Decodes one image as described above, reduction is the guess
+    // (0: full size ... 3: 1/8) and receives the guess for the next image
+    static cv::Mat decode(const std::string &filename, uint minSide, uint &reduction);
+
+private:
+    DatasetReader(const DatasetReader&);
+    DatasetReader& operator=(const DatasetReader&);
+
+    void decoder();
+
+    const FileList _files;
+    const uint _minSide;
+
+    // image i goes into slot i % queueSize, once image i - queueSize was taken from it
+    std::vector<cv::Mat> _slots;
+    std::vector<uint> _slotImage;
+    std::vector<bool> _ready;
+    uint _taken;
+    bool _stopped;
+    std::mutex _mutex;
+    std::condition_variable _changed;
+
+    std::atomic<uint> _next;
+    std::vector<std::thread> _decoders;
+};
+
+} //namespace sse
+
+#endif // DATASET_READER_H
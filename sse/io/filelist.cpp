@@ -15,71 +15,317 @@
  * limitations under the License.
 **************************************************************************/
 #include "filelist.h"
+#include "../common/random.h"
 
 #include <fstream>
 #include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <cstring>
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 namespace sse {
 
+struct FileList::Table
+{
+    Table() : count(0), offsets(NULL), chars(NULL), mapping(NULL), mappingSize(0) {}
+    ~Table() { if (mapping) munmap(mapping, mappingSize); }
+
+    std::string root;
+    size_t count;
+    // file i starts at chars + offsets[i], offsets[count] is the end of the last
+    // file. Every name is followed by a '\0' that does not belong to it
+    const uint64_t *offsets;
+    const char *chars;
+
+    // the storage, either owned ...
+    std::vector<uint64_t> ownedOffsets;
+    std::vector<char> ownedChars;
+    // ... or mapped from a packed file
+    void *mapping;
+    size_t mappingSize;
+};
+
+// Packed file format, integers are uint64 in native byte order:
+//   "SSEFLST1", number of files, size of the root directory, size of the characters,
+//   root directory (padded to a multiple of 8 bytes), offsets (number of files + 1), characters
+// The layout equals that of Table, so the file is used in place after mapping it.
+static const char PackedMagic[8] = { 'S', 'S', 'E', 'F', 'L', 'S', 'T', '1' };
+static const size_t PackedHeaderSize = sizeof(PackedMagic) + 3 * sizeof(uint64_t);
+
+static inline size_t pad8(size_t size)
+{
+    return (size + 7) / 8 * 8;
+}
+
+FileList::FileList()
+    : _table(std::make_shared<Table>())
+{
+}
+
 void FileList::randomSample(uint numOfSamples, uint seed)
 {
-    if(numOfSamples >= _files.size())
+    if(numOfSamples >= size())
         return;
 
-    std::vector<size_t> indices(_files.size());
+    std::vector<size_t> indices(size());
     for (size_t i = 0; i < indices.size(); i++) indices[i] = i;
 
-    std::random_shuffle(indices.begin(), indices.end());
+    Rng_t generator = make_rng(seed);
+    fisher_yates_shuffle(indices.begin(), indices.end(), generator);
     indices.resize(numOfSamples);
     std::sort(indices.begin(), indices.end());
 
-    std::vector<std::string> new_files(numOfSamples);
-    for (size_t i = 0; i < new_files.size(); i++) new_files[i] = _files[indices[i]];
-    _files = new_files;
+    std::vector<StringView> relative(numOfSamples);
+    for (size_t i = 0; i < relative.size(); i++) relative[i] = getRelativeFilename(indices[i]);
+    _table = pack(_table->root, relative);
 }
 
-const std::vector<std::string>& FileList::filenames() const
+uint FileList::size() const
 {
-    return _files;
+    return _table->count;
 }
 
-uint FileList::size() const
+const std::string& FileList::rootDir() const
 {
-    return _files.size();
+    return _table->root;
 }
 
-const std::string& FileList::getRelativeFilename(uint index) const
+StringView FileList::getRelativeFilename(uint index) const
 {
-    assert(index < _files.size());
-    return _files[index];
+    assert(index < _table->count);
+    const uint64_t *offsets = _table->offsets;
+    return StringView(_table->chars + offsets[index], offsets[index+1] - offsets[index] - 1);
 }
 
 std::string FileList::getFilename(uint index) const
 {
-    return getRelativeFilename(index);
+    StringView relative = getRelativeFilename(index);
+    std::string filename;
+    filename.reserve(_table->root.size() + relative.size());
+    filename.append(_table->root);
+    filename.append(relative.data(), relative.size());
+    return filename;
+}
+
+std::shared_ptr<const FileList::Table> FileList::pack(const std::string &root, const std::vector<StringView> &relative)
+{
+    std::shared_ptr<Table> table = std::make_shared<Table>();
+    table->root = root;
+    table->count = relative.size();
+
+    size_t numChars = 0;
+    for (size_t i = 0; i < relative.size(); i++) numChars += relative[i].size() + 1;
+
+    table->ownedOffsets.resize(relative.size() + 1);
+    table->ownedChars.resize(numChars);
+    uint64_t offset = 0;
+    for (size_t i = 0; i < relative.size(); i++) {
+        table->ownedOffsets[i] = offset;
+        std::copy(relative[i].begin(), relative[i].end(), table->ownedChars.begin() + offset);
+        offset += relative[i].size();
+        table->ownedChars[offset++] = '\0';
+    }
+    table->ownedOffsets[relative.size()] = offset;
+
+    table->offsets = table->ownedOffsets.data();
+    table->chars = table->ownedChars.data();
+    return table;
+}
+
+void FileList::assign(const std::vector<StringView> &paths)
+{
+    // longest directory all paths have in common
+    size_t prefix = 0;
+    if (!paths.empty()) {
+        prefix = paths[0].size();
+        for (size_t i = 1; i < paths.size() && prefix > 0; i++) {
+            size_t common = 0;
+            size_t n = std::min(prefix, paths[i].size());
+            while (common < n && paths[i][common] == paths[0][common]) common++;
+            prefix = common;
+        }
+        while (prefix > 0 && paths[0][prefix-1] != '/') prefix--;
+    }
+
+    std::vector<StringView> relative(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        relative[i] = StringView(paths[i].data() + prefix, paths[i].size() - prefix);
+    }
+    _table = pack(paths.empty() ? std::string() : paths[0].str().substr(0, prefix), relative);
+}
+
+static bool is_packed(const std::string &filename)
+{
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    char magic[sizeof(PackedMagic)];
+    in.read(magic, sizeof(magic));
+    return in && std::equal(magic, magic + sizeof(magic), PackedMagic);
 }
 
 void FileList::load(const std::string &filename)
 {
-    std::ifstream in(filename.c_str());
+    if (is_packed(filename)) {
+        std::shared_ptr<Table> table = std::make_shared<Table>();
 
-    std::vector<std::string> files;
-    std::string line;
-    while(getline(in, line)) {
-        files.push_back(line);
+        int fd = open(filename.c_str(), O_RDONLY);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            if (fd >= 0) close(fd);
+            throw std::runtime_error("can not open " + filename);
+        }
+        table->mappingSize = info.st_size;
+        void *mapping = mmap(NULL, table->mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+            throw std::runtime_error("can not map " + filename);
+        table->mapping = mapping;
+
+        const char *bytes = static_cast<const char*>(mapping);
+        const uint64_t *header = reinterpret_cast<const uint64_t*>(bytes + sizeof(PackedMagic));
+        if (table->mappingSize < PackedHeaderSize)
+            throw std::runtime_error("truncated filelist " + filename);
+        uint64_t count = header[0], rootSize = header[1], charsSize = header[2];
+        size_t offsetsStart = PackedHeaderSize + pad8(rootSize);
+        size_t charsStart = offsetsStart + (count + 1) * sizeof(uint64_t);
+        if (charsStart + charsSize != table->mappingSize)
+            throw std::runtime_error("truncated filelist " + filename);
+
+        table->root.assign(bytes + PackedHeaderSize, rootSize);
+        table->count = count;
+        table->offsets = reinterpret_cast<const uint64_t*>(bytes + offsetsStart);
+        table->chars = bytes + charsStart;
+        if (table->offsets[count] != charsSize)
+            throw std::runtime_error("corrupt filelist " + filename);
+
+        _table = table;
+        return;
+    }
+
+    // the whole file at once, then split into lines
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    std::string text;
+    if (in) {
+        in.seekg(0, std::ios::end);
+        text.resize(static_cast<size_t>(in.tellg()));
+        in.seekg(0, std::ios::beg);
+        in.read(&text[0], text.size());
     }
-    in.close();
-    _files = files;
+
+    std::vector<StringView> paths;
+    size_t begin = 0;
+    while (begin < text.size()) {
+        size_t end = text.find('\n', begin);
+        if (end == std::string::npos) end = text.size();
+        size_t length = end - begin;
+        if (length > 0 && text[begin + length - 1] == '\r') length--;
+        paths.push_back(StringView(text.data() + begin, length));
+        begin = end + 1;
+    }
+    assign(paths);
 }
 
-void FileList::store(const std::string &filename) const
+void FileList::store(const std::string &filename, bool packed) const
 {
-    std::ofstream out(filename.c_str());
-    for(int i = 0; i < _files.size(); i++) {
-        out << _files[i] << std::endl;
+    if (!packed) {
+        std::ofstream out(filename.c_str());
+        for (uint i = 0; i < size(); i++) {
+            out << _table->root << getRelativeFilename(i) << std::endl;
+        }
+        out.close();
+        return;
     }
+
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    const uint64_t count = _table->count;
+    const uint64_t header[3] = { count, _table->root.size(), _table->offsets[count] };
+    out.write(PackedMagic, sizeof(PackedMagic));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    std::string root = _table->root;
+    root.resize(pad8(root.size()), '\0');
+    out.write(root.data(), root.size());
+
+    out.write(reinterpret_cast<const char*>(_table->offsets), (count + 1) * sizeof(uint64_t));
+    out.write(_table->chars, _table->offsets[count]);
     out.close();
 }
 
+void FileList::scan(const std::string &rootDir, const std::string &pattern, uint numThreads)
+{
+    char resolved[PATH_MAX];
+    if (!realpath(rootDir.c_str(), resolved))
+        throw std::runtime_error("can not open directory " + rootDir);
+
+    std::mutex mutex;
+    std::condition_variable available;
+    std::deque<std::string> directories(1, resolved);
+    uint busy = 0;
+    std::vector<std::vector<std::string> > found(std::max(1u, numThreads));
+
+    std::vector<std::thread> threads;
+    for (uint t = 0; t < found.size(); t++) {
+        threads.push_back(std::thread([&, t]() {
+            for (;;) {
+                std::string directory;
+                {
+                    std::unique_lock<std::mutex> locker(mutex);
+                    available.wait(locker, [&]() { return !directories.empty() || busy == 0; });
+                    if (directories.empty())
+                        return;
+                    directory = directories.front();
+                    directories.pop_front();
+                    busy++;
+                }
+
+                std::vector<std::string> subdirectories;
+                DIR *dir = opendir(directory.c_str());
+                if (dir) {
+                    while (struct dirent *entry = readdir(dir)) {
+                        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) continue;
+
+                        std::string path = directory + "/" + entry->d_name;
+                        bool isDirectory = entry->d_type == DT_DIR;
+                        if (entry->d_type == DT_UNKNOWN) {
+                            struct stat info;
+                            isDirectory = lstat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+                        }
+
+                        // like find, symbolic links to directories are not followed
+                        if (isDirectory)
+                            subdirectories.push_back(path);
+                        else if (fnmatch(pattern.c_str(), entry->d_name, 0) == 0)
+                            found[t].push_back(path);
+                    }
+                    closedir(dir);
+                }
+
+                std::lock_guard<std::mutex> locker(mutex);
+                directories.insert(directories.end(), subdirectories.begin(), subdirectories.end());
+                busy--;
+                available.notify_all();
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); t++) threads[t].join();
+
+    std::vector<std::string> files;
+    for (size_t t = 0; t < found.size(); t++) files.insert(files.end(), found[t].begin(), found[t].end());
+    std::sort(files.begin(), files.end());
+
+    std::vector<StringView> paths(files.begin(), files.end());
+    assign(paths);
 }
 
+} //namespace sse
@@ -18,37 +18,61 @@
 #define FILELIST_H
 
 #include "../common/types.h"
+#include "../common/string_view.h"
+
+#include <memory>
 
 namespace sse {
 
+/**
+ * @brief List of image files
+ *
+ * All paths are stored relative to one root directory (the longest directory
+ * all files share), packed into a single character buffer plus offsets, so
+ * that millions of files cost no per file allocation. Accessors return views
+ * into that buffer. Copies share the buffer.
+ *
+ * Two file formats: text, one absolute path per line, and a packed binary
+ * format (see store()) that load() maps into memory instead of reading it.
+ */
 class FileList
 {
 public:
+    FileList();
+
     // Subsample given filelist randomly
+    // The same seed always picks the same files
     void randomSample(uint numOfSamples, uint seed);
 
-    // Vector of all filenames
-    const std::vector<std::string>& filenames() const;
     uint size() const;
 
-    //Access relative filename of file i
+    // Root directory all files are relative to, ends with '/' unless empty
+    const std::string& rootDir() const;
+    //Access relative filename of file i, the view is null terminated
     //index: [0, size()-1]
-    const std::string& getRelativeFilename(uint index) const;
+    StringView getRelativeFilename(uint index) const;
     //Access 'absolute' filename of file i
     //index: [0, size()-1]
     std::string getFilename(uint index) const;
 
-    //Load a FileList
-    //Note that you Must setRootDir
+    //Load a FileList, text or packed
     void load(const std::string &filename);
-    //Store a FileList
-    //Note that the root directory is not stored, only
-    //the list of filenames relative to the root directory.
-    void store(const std::string &filename)const;
+    //Store a FileList, the text format lists the absolute paths
+    void store(const std::string &filename, bool packed = false) const;
+
+    // Lists the files below rootDir whose name matches pattern (a shell
+    // wildcard, e.g. "*.png"), sorted. Directories are read by numThreads threads.
+    void scan(const std::string &rootDir, const std::string &pattern, uint numThreads = 1);
 
 private:
-    std::vector<std::string> _files;
-    std::string _rootDir;
+    struct Table;
+
+    // Replaces the content by the given paths, which are made relative to their common directory
+    void assign(const std::vector<StringView> &paths);
+    // Table of root + the given relative paths
+    static std::shared_ptr<const Table> pack(const std::string &root, const std::vector<StringView> &relative);
+
+    std::shared_ptr<const Table> _table;
 };
 
 } //namespace sse
@@ -8,7 +8,8 @@
 using namespace std;
 
 enum VALUE_TYPE {
-	UINT
+	UINT,
+	FLOAT
 };
 
 template <class T>
@@ -18,6 +19,10 @@ T convert(const string &value, VALUE_TYPE type)
 		char *end;
 		return static_cast<T>(strtol(value.c_str(), &end, 10));
 	}
+	if (type == FLOAT) {
+		char *end;
+		return static_cast<T>(strtod(value.c_str(), &end));
+	}
 	return T(0);
 };
 
@@ -17,6 +17,8 @@
 #include "reader_writer.h"
 
 #include <fstream>
+#include <algorithm>
+#include <stdexcept>
 
 namespace sse {
 
@@ -104,14 +106,23 @@ void readSamplesForCluster(const std::string &filename, Features_t &samples,
         uint col = 0;
         in >> col;
 
-         for(uint i = 0; i < row; i++) {
-            Vec_f32_t vf;
-            float temp;
+        // an image without features, its column count says nothing
+        if(row == 0) {
+            if(callback)
+                callback(n, size, info);
+            continue;
+        }
+
+        if(samples.empty())
+            samples.create(0, col);
+        assert(samples.cols() == col);
+        samples.reserve(samples.size() + row);
+
+        for(uint i = 0; i < row; i++) {
+            float *vf = samples.append();
             for(uint j = 0; j < col; j++) {
-                in >> temp;
-                vf.push_back(temp);
+                in >> vf[j];
             }
-            samples.push_back(vf);
         }
 
         if(callback)
@@ -208,4 +219,113 @@ void read(std::ifstream &in, std::vector<Vec_f32_t> &vv,
     }
 }
 
+void read(std::ifstream &in, Matrix_f32_t &m,
+    Callback_fn callback, const std::string &info)
+{
+    uint row = 0;
+    uint col = 0;
+    in >> row;
+    in >> col;
+
+    // an image without features, its column count says nothing
+    if(row == 0)
+        return;
+
+    if(m.empty())
+        m.create(0, col);
+    assert(m.cols() == col);
+    m.reserve(m.size() + row);
+
+    for(uint i = 0; i < row; i++) {
+        float *vf = m.append();
+        for(uint j = 0; j < col; j++) {
+            in >> vf[j];
+        }
+
+        if(callback)
+            callback(i, row, info);
+    }
+}
+
+void write(const Matrix_f32_t &m, std::ofstream &out,
+    Callback_fn callback, const std::string &info)
+{
+    // no rows for an image without features, readers skip it
+    out << m.size() <<std::endl;
+    out << m.cols() <<std::endl;
+
+    uint row = m.size();
+    uint col = m.cols();
+    for(uint i = 0; i < row; i++) {
+        const float *vf = m.row(i);
+        for(uint j = 0; j < col; j++) {
+            out << vf[j] << " ";
+        }
+        out << std::endl;
+        if(callback)
+            callback(i, row, info);
+    }
+}
+
+static const char SparseHistogramMagic[8] = { 'S', 'S', 'E', 'H', 'I', 'S', 'T', '1' };
+
+bool isSparseHistogramFile(const std::string &filename)
+{
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    char magic[sizeof(SparseHistogramMagic)];
+    in.read(magic, sizeof(magic));
+    return in && std::equal(magic, magic + sizeof(magic), SparseHistogramMagic);
+}
+
+void writeSparseHistogramHeader(std::ofstream &out, uint numOfHistograms, uint vocabularySize)
+{
+    uint32_t header[2] = { numOfHistograms, vocabularySize };
+    out.write(SparseHistogramMagic, sizeof(SparseHistogramMagic));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+}
+
+void readSparseHistogramHeader(std::ifstream &in, uint &numOfHistograms, uint &vocabularySize)
+{
+    char magic[sizeof(SparseHistogramMagic)];
+    uint32_t header[2];
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    if(!in || !std::equal(magic, magic + sizeof(magic), SparseHistogramMagic))
+        throw std::runtime_error("not a sparse histogram file");
+
+    numOfHistograms = header[0];
+    vocabularySize = header[1];
+}
+
+void write(const SparseHist_t &hist, std::ofstream &out)
+{
+    uint32_t size = hist.size();
+    out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    for(uint i = 0; i < hist.size(); i++) {
+        uint32_t word = hist[i].first;
+        float count = hist[i].second;
+        out.write(reinterpret_cast<const char*>(&word), sizeof(word));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    }
+}
+
+void read(std::ifstream &in, SparseHist_t &hist)
+{
+    uint32_t size = 0;
+    in.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if(!in)
+        throw std::runtime_error("truncated sparse histogram file");
+
+    hist.resize(size);
+    for(uint i = 0; i < size; i++) {
+        uint32_t word;
+        float count;
+        in.read(reinterpret_cast<char*>(&word), sizeof(word));
+        in.read(reinterpret_cast<char*>(&count), sizeof(count));
+        hist[i] = Term_t(word, count);
+    }
+    if(!in)
+        throw std::runtime_error("truncated sparse histogram file");
+}
+
 } //namespace sse
@@ -54,6 +54,26 @@ void read(std::ifstream &in, std::vector<Vec_f32_t> &vv,
 void write(const std::vector<Vec_f32_t> &vv, std::ofstream &out,
            Callback_fn callback = Callback_fn(), const std::string &info = "");
 
+//Same as above for keypoints and features stored in a Matrix
+//(same file format), read appends the rows to the matrix
+void read(std::ifstream &in, Matrix_f32_t &m,
+          Callback_fn callback = Callback_fn(), const std::string &info = "");
+
+void write(const Matrix_f32_t &m, std::ofstream &out,
+           Callback_fn callback = Callback_fn(), const std::string &info = "");
+
+//Binary file of sparse histograms (quantized images):
+//  "SSEHIST1", uint32 number of histograms, uint32 vocabulary size,
+//  then per histogram: uint32 number of terms, (uint32 word id, float32 count) per term
+//Open the stream in binary mode, the read functions throw std::runtime_error on malformed files
+bool isSparseHistogramFile(const std::string &filename);
+
+void writeSparseHistogramHeader(std::ofstream &out, uint numOfHistograms, uint vocabularySize);
+void readSparseHistogramHeader(std::ifstream &in, uint &numOfHistograms, uint &vocabularySize);
+
+void write(const SparseHist_t &hist, std::ofstream &out);
+void read(std::ifstream &in, SparseHist_t &hist);
+
 
 } //namespace sse
 
@@ -3,13 +3,22 @@
 
 #include "opensse/common/distance.h"
 #include "opensse/common/types.h"
+#include "opensse/common/random.h"
+#include "opensse/common/matrix.h"
+#include "opensse/common/string_view.h"
+#include "opensse/common/trace.h"
 #include "opensse/features/galif.h"
 #include "opensse/index/invertedindex.h"
 #include "opensse/io/filelist.h"
+#include "opensse/io/dataset_reader.h"
 #include "opensse/io/reader_writer.h"
 #include "opensse/io/json_parser.h"
 #include "opensse/quantize/quantizer.h"
+#include "opensse/search/searcher.h"
+#include "opensse/search/querycache.h"
+#include "opensse/search/session.h"
 #include "opensse/vocabulary/kmeans_init.h"
 #include "opensse/vocabulary/kmeans.h"
+#include "opensse/vocabulary/sample_store.h"
 
 #endif
\ No newline at end of file
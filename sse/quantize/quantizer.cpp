@@ -15,21 +15,81 @@
  * limitations under the License.
 **************************************************************************/
 #include "quantizer.h"
+#include "../common/trace.h"
+
+#include <algorithm>
 
 namespace sse {
 
 //Quantize one image
 void quantize(const Features_t &features, const Vocabularys_t &vocabulary,
-              Vec_f32_t &vf, QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer)
+              Vec_f32_t &vf, const QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer)
 {
+    SSE_TRACE_SCOPE(TraceQuantize);
     Vocabularys_t quantized_samples;
     quantize_samples_parallel(features, vocabulary, quantized_samples, quantizer);
 
     build_histvw(quantized_samples, vocabulary.size(), vf, false);
 }
 
+void quantize(const Features_t &features, const Vocabularys_t &vocabulary,
+              SparseHist_t &hist, const QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer)
+{
+    SSE_TRACE_SCOPE(TraceQuantize);
+    std::vector<uint> words(features.size());
+    for(uint i = 0; i < features.size(); i++) {
+        words[i] = quantizer.nearest(features[i], vocabulary);
+    }
+    std::sort(words.begin(), words.end());
+
+    hist.clear();
+    for(uint i = 0; i < words.size(); i++) {
+        if(hist.empty() || hist.back().first != words[i])
+            hist.push_back(Term_t(words[i], 0));
+        hist.back().second++;
+    }
+}
+
+void quantize(const Features_t &features, const Vocabularys_t &vocabulary,
+              Vec_f32_t &vf, const QuantizerFuzzy<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer)
+{
+    SSE_TRACE_SCOPE(TraceQuantize);
+    std::vector<SparseHist_t> weights(features.size());
+#pragma omp parallel for
+    for(uint i = 0; i < features.size(); i++) {
+        quantizer.weights(features[i], vocabulary, weights[i]);
+    }
+
+    vf.assign(vocabulary.size(), 0);
+    for(uint i = 0; i < weights.size(); i++) {
+        for(uint j = 0; j < weights[i].size(); j++) {
+            vf[weights[i][j].first] += weights[i][j].second;
+        }
+    }
+}
+
+void quantize(const Features_t &features, const Vocabularys_t &vocabulary,
+              SparseHist_t &hist, const QuantizerFuzzy<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer)
+{
+    SSE_TRACE_SCOPE(TraceQuantize);
+    SparseHist_t words, weights;
+    words.reserve(features.size() * quantizer.numOfNearest());
+    for(uint i = 0; i < features.size(); i++) {
+        quantizer.weights(features[i], vocabulary, weights);
+        words.insert(words.end(), weights.begin(), weights.end());
+    }
+    std::sort(words.begin(), words.end());
+
+    hist.clear();
+    for(uint i = 0; i < words.size(); i++) {
+        if(hist.empty() || hist.back().first != words[i].first)
+            hist.push_back(Term_t(words[i].first, 0));
+        hist.back().second += words[i].second;
+    }
+}
+
 void quantize_samples_parallel(const Features_t &samples, const Vocabularys_t &vocabulary,
-                               Vocabularys_t &quantized_samples, QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer)
+                               Vocabularys_t &quantized_samples, const QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer)
 {
     quantized_samples.resize(samples.size());
 
@@ -40,6 +100,17 @@ void quantize_samples_parallel(const Features_t &samples, const Vocabularys_t &v
     }
 }
 
+void quantize_samples_parallel(const Features_t &samples, const Vocabularys_t &vocabulary,
+                               Vocabularys_t &quantized_samples, const QuantizerFuzzy<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer)
+{
+    quantized_samples.resize(samples.size());
+
+#pragma omp parallel for
+    for(uint i = 0; i < samples.size(); i++) {
+        quantizer.quantize(samples[i], vocabulary, quantized_samples[i]);
+    }
+}
+
 void build_histvw(const Vocabularys_t &quantized_samples, uint vocabulary_size, Vec_f32_t &histvw,
                   bool normalize, const KeyPoints_t &keypoints, int res)
 {
@@ -20,6 +20,8 @@
 #include "../common/types.h"
 #include "../common/distance.h"
 
+#include <algorithm>
+
 namespace sse {
 
 /**
@@ -50,15 +52,22 @@ public:
      * the 'interface' similar to that of quantize_fuzzy such that both functors can be easily
      * exchanged for each other.
      *
-     * @param sample Sample to be quantized
+     * @param sample Sample to be quantized, a Sample_t or a row of a Features_t
      * @param vocabulary Vocabulary
      * @param quantized_sample
      */
-    void quantize(const Sample_t& sample, const std::vector<Sample_t>& vocabulary, Vec_f32_t& quantized_sample)
+    template <class Row_t>
+    void quantize(const Row_t& sample, const std::vector<Sample_t>& vocabulary, Vec_f32_t& quantized_sample) const
     {
         //quantized_sample.size() == vocabulary.size()
         quantized_sample.resize(vocabulary.size());
+        quantized_sample[nearest(sample, vocabulary)] = 1;
+    }
 
+    // Index of the vocabulary entry closest to sample, the last one if several are equally close
+    template <class Row_t>
+    uint nearest(const Row_t& sample, const std::vector<Sample_t>& vocabulary) const
+    {
         uint closest = 0;
         float minDistance = std::numeric_limits<float>::max();
 
@@ -72,35 +81,62 @@ public:
             }
         }
 
-        quantized_sample[closest] = 1;
+        return closest;
     }
 };
 
 /**
  * @brief Functor performing soft quantization of a sample against a given codebook of samples
+ *
+ * Only the numOfNearest vocabulary entries closest to the sample get a weight, the
+ * others would get next to nothing but cost an exp each. The weight of an entry at
+ * distance d (under Dist_fn, the squared L2 distance makes it a gaussian kernel) is
+ * exp(-d / (2 sigma^2)), normalized such that the weights of a sample sum up to 1.
+ * With numOfNearest = 1 this gives the same words as QuantizerHard.
  */
 template <class Sample_t, class Dist_fn>
-class QuantizeFuzzy
+class QuantizerFuzzy
 {
 public:
-    QuantizeFuzzy(float sigma) :_sigma(sigma)
+    QuantizerFuzzy(float sigma = 0.2, uint numOfNearest = 3) : _sigma(sigma), _numOfNearest(numOfNearest)
     {
         assert(_sigma > 0);
+        assert(_numOfNearest > 0);
     }
 
-    void operator () (const Sample_t& sample, const std::vector<Sample_t>& vocabulary, Vec_f32_t& quantized_sample)
+    // dense version of weights(), for the same interface as QuantizerHard
+    template <class Row_t>
+    void quantize(const Row_t& sample, const std::vector<Sample_t>& vocabulary, Vec_f32_t& quantized_sample) const
     {
-        //quantized_sample.size() == vocabulary.size()
-        quantized_sample.resize(vocabulary.size());
+        SparseHist_t words;
+        weights(sample, vocabulary, words);
 
-        float sigma2 = 2*_sigma*_sigma;
-        float sum = 0;
+        quantized_sample.assign(vocabulary.size(), 0);
+        for(uint i = 0; i < words.size(); i++) {
+            quantized_sample[words[i].first] = words[i].second;
+        }
+    }
+
+    // weights of the numOfNearest closest vocabulary entries, ordered by word id
+    template <class Row_t>
+    void weights(const Row_t& sample, const std::vector<Sample_t>& vocabulary, SparseHist_t& words) const
+    {
+        words.clear();
+        if(vocabulary.empty()) return;
+
+        Dist_fn dist;
 
+        // (distance, word) of the closest entries so far, the closest first. Of equally close
+        // entries the later one comes first, QuantizerHard also takes the last one
+        std::vector<std::pair<float, uint> > nearest;
+        nearest.reserve(_numOfNearest + 1);
         for(uint i = 0; i < vocabulary.size(); i++) {
-            float d = dist(sample, vocabulary[i]);
-            float e = exp(-d*d / sigma2);
-            sum += e;
-            quantized_sample[i] = e;
+            float distance = dist(sample, vocabulary[i]);
+            if(nearest.size() == _numOfNearest && distance > nearest.back().first) continue;
+
+            nearest.insert(std::lower_bound(nearest.begin(), nearest.end(), std::make_pair(distance, 0u)),
+                           std::make_pair(distance, i));
+            if(nearest.size() > _numOfNearest) nearest.pop_back();
         }
 
         // Normalize such that sum(result) = 1 (L1 norm)
@@ -108,13 +144,28 @@ public:
         // resulting histogram, If we wouldn't normalize, some features (that are close to several
         // entries in the vocabulary) would contribute more energy than others.
         // This is exactly the approach taken by Chatterfield et al. -- The devil is in the details
-        for(uint i = 0; i < quantized_sample.size(); i++) {
-            quantized_sample[i] /= sum;
+        // Distances are taken relative to the closest one, which cancels out here but keeps
+        // the exp of the closest entry at 1 rather than underflowing for far away samples.
+        const float sigma2 = 2*_sigma*_sigma;
+        float sum = 0;
+        words.resize(nearest.size());
+        for(uint i = 0; i < nearest.size(); i++) {
+            float e = std::exp(-(nearest[i].first - nearest[0].first) / sigma2);
+            words[i] = Term_t(nearest[i].second, e);
+            sum += e;
+        }
+        for(uint i = 0; i < words.size(); i++) {
+            words[i].second /= sum;
         }
+        std::sort(words.begin(), words.end());
     }
 
+    float sigma() const { return _sigma; }
+    uint numOfNearest() const { return _numOfNearest; }
+
 private:
     float _sigma;
+    uint _numOfNearest;
 };
 
 /**
@@ -126,7 +177,9 @@ private:
  * @param quantizer quantization function to be used
  */
 void quantize_samples_parallel(const Features_t &samples, const Vocabularys_t &vocabulary,
-                               Vocabularys_t &quantized_samples, QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer);
+                               Vocabularys_t &quantized_samples, const QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer);
+void quantize_samples_parallel(const Features_t &samples, const Vocabularys_t &vocabulary,
+                               Vocabularys_t &quantized_samples, const QuantizerFuzzy<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer);
 
 // Given a list of quantized samples and corresponding coordinates
 // compute the (spatialized) histogram of visual words out of that.
@@ -144,7 +197,17 @@ void build_histvw(const Vocabularys_t &quantized_samples, uint vocabulary_size,
 
 //Quantize one image with some default parameters
 void quantize(const Features_t &features, const Vocabularys_t &vocabulary,
-              Vec_f32_t &vf, QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer);
+              Vec_f32_t &vf, const QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer);
+
+//Same as above, the histogram only contains the words that occur
+void quantize(const Features_t &features, const Vocabularys_t &vocabulary,
+              SparseHist_t &hist, const QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer);
+
+//Soft quantization of one image, every feature adds its weights() rather than a single 1
+void quantize(const Features_t &features, const Vocabularys_t &vocabulary,
+              Vec_f32_t &vf, const QuantizerFuzzy<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer);
+void quantize(const Features_t &features, const Vocabularys_t &vocabulary,
+              SparseHist_t &hist, const QuantizerFuzzy<Vec_f32_t, L2norm_squared<Vec_f32_t> > &quantizer);
 } //namespace sse
 
 
@@ -0,0 +1,95 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include "querycache.h"
+
+namespace sse {
+
+// FNV-1a, 64 bit
+static const uint64_t FnvOffset = 14695981039346656037ULL;
+static const uint64_t FnvPrime = 1099511628211ULL;
+
+static inline uint64_t fnv1a(const unsigned char *data, size_t size, uint64_t hash = FnvOffset)
+{
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= FnvPrime;
+    }
+    return hash;
+}
+
+QueryCache::QueryCache(size_t capacity, std::chrono::steady_clock::duration ttl)
+    : _images(capacity, ttl), _words(capacity, ttl)
+{
+}
+
+size_t QueryCache::ImageKeyHash::operator()(const ImageKey &k) const
+{
+    return static_cast<size_t>(k.hash ^ (static_cast<uint64_t>(k.numOfResults) * FnvPrime));
+}
+
+size_t QueryCache::WordsKeyHash::operator()(const WordsKey &k) const
+{
+    uint64_t hash = fnv1a(reinterpret_cast<const unsigned char*>(&k.numOfResults), sizeof(k.numOfResults));
+    for (size_t i = 0; i < k.words.size(); i++) {
+        // word and count separately, a Term_t may contain padding
+        hash = fnv1a(reinterpret_cast<const unsigned char*>(&k.words[i].first), sizeof(k.words[i].first), hash);
+        hash = fnv1a(reinterpret_cast<const unsigned char*>(&k.words[i].second), sizeof(k.words[i].second), hash);
+    }
+    return static_cast<size_t>(hash);
+}
+
+QueryCache::ImageKey QueryCache::imageKey(const std::vector<unsigned char> &encoded, uint numOfResults, bool copy)
+{
+    typedef std::vector<unsigned char> Bytes_t;
+    ImageKey key;
+    key.hash = fnv1a(encoded.data(), encoded.size());
+    // without a copy the key does not own the bytes, it must not outlive encoded
+    key.bytes = copy ? std::make_shared<const Bytes_t>(encoded)
+                     : std::shared_ptr<const Bytes_t>(std::shared_ptr<const Bytes_t>(), &encoded);
+    key.numOfResults = numOfResults;
+    return key;
+}
+
+bool QueryCache::getImage(const std::vector<unsigned char> &encoded, uint numOfResults, std::vector<ResultItem_t> &results)
+{
+    return _images.get(imageKey(encoded, numOfResults, false), results);
+}
+
+void QueryCache::putImage(const std::vector<unsigned char> &encoded, uint numOfResults, const std::vector<ResultItem_t> &results)
+{
+    _images.put(imageKey(encoded, numOfResults, true), results);
+}
+
+bool QueryCache::getWords(const SparseHist_t &words, uint numOfResults, std::vector<ResultItem_t> &results)
+{
+    WordsKey key = { words, numOfResults };
+    return _words.get(key, results);
+}
+
+void QueryCache::putWords(const SparseHist_t &words, uint numOfResults, const std::vector<ResultItem_t> &results)
+{
+    WordsKey key = { words, numOfResults };
+    _words.put(key, results);
+}
+
+void QueryCache::clear()
+{
+    _images.clear();
+    _words.clear();
+}
+
+} //namespace sse
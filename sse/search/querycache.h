@@ -0,0 +1,180 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#ifndef QUERYCACHE_H
+#define QUERYCACHE_H
+
+#include "../common/types.h"
+
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+
+namespace sse {
+
+/**
+ * @brief Least recently used cache with a maximum number of entries
+ *
+ * Entries older than ttl are treated as missing, a ttl of zero keeps them
+ * until they are evicted. All members may be called from several threads.
+ */
+template <class Key, class Value, class Hash>
+class LruCache
+{
+public:
+    typedef std::chrono::steady_clock Clock_t;
+
+    LruCache(size_t capacity, Clock_t::duration ttl)
+        : _capacity(capacity), _ttl(ttl), _hits(0), _misses(0) {}
+
+    bool get(const Key &key, Value &value)
+    {
+        std::lock_guard<std::mutex> locker(_mutex);
+        typename Index_t::iterator found = _index.find(key);
+        if (found == _index.end()) {
+            _misses++;
+            return false;
+        }
+
+        typename List_t::iterator entry = found->second;
+        if (_ttl != Clock_t::duration::zero() && Clock_t::now() - entry->inserted > _ttl) {
+            _index.erase(found);
+            _entries.erase(entry);
+            _misses++;
+            return false;
+        }
+
+        // move to the front, the back is evicted first
+        _entries.splice(_entries.begin(), _entries, entry);
+        value = entry->value;
+        _hits++;
+        return true;
+    }
+
+    void put(const Key &key, const Value &value)
+    {
+        if (_capacity == 0) return;
+
+        std::lock_guard<std::mutex> locker(_mutex);
+        typename Index_t::iterator found = _index.find(key);
+        if (found != _index.end()) {
+            _entries.erase(found->second);
+            _index.erase(found);
+        }
+
+        _entries.push_front(Entry(key, value, Clock_t::now()));
+        _index[key] = _entries.begin();
+
+        if (_entries.size() > _capacity) {
+            _index.erase(_entries.back().key);
+            _entries.pop_back();
+        }
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> locker(_mutex);
+        _index.clear();
+        _entries.clear();
+    }
+
+    size_t size() const { std::lock_guard<std::mutex> locker(_mutex); return _entries.size(); }
+    size_t hits() const { std::lock_guard<std::mutex> locker(_mutex); return _hits; }
+    size_t misses() const { std::lock_guard<std::mutex> locker(_mutex); return _misses; }
+
+private:
+    struct Entry
+    {
+        Entry(const Key &k, const Value &v, Clock_t::time_point t) : key(k), value(v), inserted(t) {}
+        Key key;
+        Value value;
+        Clock_t::time_point inserted;
+    };
+    typedef std::list<Entry> List_t;
+    typedef std::unordered_map<Key, typename List_t::iterator, Hash> Index_t;
+
+    const size_t _capacity;
+    const Clock_t::duration _ttl;
+
+    mutable std::mutex _mutex;
+    List_t _entries;
+    Index_t _index;
+    size_t _hits;
+    size_t _misses;
+};
+
+/**
+ * @brief Results of recent queries, see Searcher::enableCache
+ *
+ * Two levels: the encoded image bytes of a query, which skip all the work
+ * for repeated requests, and the visual words of a query, which also catch
+ * sketches whose pixels differ but whose words are the same. Both are keyed
+ * together with the number of results asked for.
+ */
+class QueryCache
+{
+public:
+    // capacity entries per level, entries expire after ttl (zero: never)
+    QueryCache(size_t capacity, std::chrono::steady_clock::duration ttl);
+
+    bool getImage(const std::vector<unsigned char> &encoded, uint numOfResults, std::vector<ResultItem_t> &results);
+    void putImage(const std::vector<unsigned char> &encoded, uint numOfResults, const std::vector<ResultItem_t> &results);
+
+    bool getWords(const SparseHist_t &words, uint numOfResults, std::vector<ResultItem_t> &results);
+    void putWords(const SparseHist_t &words, uint numOfResults, const std::vector<ResultItem_t> &results);
+
+    // forgets all results, e.g. when the index changes
+    void clear();
+
+    size_t imageHits() const { return _images.hits(); }
+    size_t imageMisses() const { return _images.misses(); }
+    size_t wordHits() const { return _words.hits(); }
+    size_t wordMisses() const { return _words.misses(); }
+
+private:
+    // the entries keep a copy of the bytes, a hit compares them and not only the hash. The
+    // copy is shared by the list entry and the index, a lookup refers to the caller's bytes
+    struct ImageKey
+    {
+        uint64_t hash;
+        std::shared_ptr<const std::vector<unsigned char> > bytes;
+        uint numOfResults;
+        bool operator==(const ImageKey &k) const
+        {
+            return hash == k.hash && numOfResults == k.numOfResults && *bytes == *k.bytes;
+        }
+    };
+    struct ImageKeyHash { size_t operator()(const ImageKey &k) const; };
+
+    struct WordsKey
+    {
+        SparseHist_t words;
+        uint numOfResults;
+        bool operator==(const WordsKey &k) const { return words == k.words && numOfResults == k.numOfResults; }
+    };
+    struct WordsKeyHash { size_t operator()(const WordsKey &k) const; };
+
+    static ImageKey imageKey(const std::vector<unsigned char> &encoded, uint numOfResults, bool copy);
+
+    LruCache<ImageKey, std::vector<ResultItem_t>, ImageKeyHash> _images;
+    LruCache<WordsKey, std::vector<ResultItem_t>, WordsKeyHash> _words;
+};
+
+} //namespace sse
+
+#endif // QUERYCACHE_H
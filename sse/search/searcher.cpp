@@ -0,0 +1,202 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include "searcher.h"
+#include "../io/reader_writer.h"
+#include "../common/trace.h"
+
+#include <stdexcept>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+
+namespace sse {
+
+Searcher::Snapshot::Snapshot(const Searcher &searcher, uint64_t version)
+    : _galif(searcher._galif), _softQuantizer(searcher._softQuantizer)
+    , _numOfViews(searcher._numOfViews), _version(version)
+{
+    _index.load(searcher._indexFile);
+    read(searcher._vocabularyFile, _vocabulary);
+    _files.load(searcher._fileList);
+
+    if(searcher._cacheCapacity > 0)
+        _cache.reset(new QueryCache(searcher._cacheCapacity, searcher._cacheTtl));
+}
+
+Searcher::Searcher(const std::string &indexFile, const std::string &vocabularyFile,
+                   const std::string &fileList, uint numOfViews)
+    : _indexFile(indexFile), _vocabularyFile(vocabularyFile), _fileList(fileList)
+    , _numOfViews(numOfViews), _cacheCapacity(0), _cacheTtl(std::chrono::steady_clock::duration::zero())
+    , _softQuantizer(0.2, 1)
+    , _reloading(false)
+{
+    assert(_numOfViews > 0);
+
+    _snapshot.reset(new Snapshot(*this, 0));
+}
+
+Searcher::~Searcher()
+{
+    if(_reloader.joinable())
+        _reloader.join();
+}
+
+void Searcher::enableCache(size_t capacity, std::chrono::steady_clock::duration ttl)
+{
+    _cacheCapacity = capacity;
+    _cacheTtl = ttl;
+    _snapshot->_cache.reset(new QueryCache(capacity, ttl));
+}
+
+void Searcher::enableSoftQuantization(uint numOfNearest, float sigma)
+{
+    _softQuantizer = QuantizerFuzzy<Vec_f32_t, L2norm_squared<Vec_f32_t> >(sigma, numOfNearest);
+    _snapshot->_softQuantizer = _softQuantizer;
+    // the words of a cached query depend on the quantizer
+    if(_snapshot->_cache)
+        _snapshot->_cache.reset(new QueryCache(_cacheCapacity, _cacheTtl));
+}
+
+void Searcher::reload()
+{
+    std::lock_guard<std::mutex> locker(_reloadMutex);
+
+    // loading takes long, queries keep using the current snapshot meanwhile
+    std::shared_ptr<Snapshot> fresh(new Snapshot(*this, std::atomic_load(&_snapshot)->_version + 1));
+    std::shared_ptr<Snapshot> old = std::atomic_exchange(&_snapshot, fresh);
+
+    // free the old snapshot here rather than in the query that happens to release it last,
+    // that query would pay for it. Give up waiting if somebody holds on to it for long.
+    for(int i = 0; i < 10000 && old.use_count() > 1; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    old.reset();
+}
+
+bool Searcher::reloadInBackground()
+{
+    if(_reloading.exchange(true))
+        return false;
+
+    if(_reloader.joinable())
+        _reloader.join();
+    _reloader = std::thread([this]() {
+        try {
+            reload();
+        }
+        catch(const std::exception &e) {
+            std::cerr << "reload failed: " << e.what() << std::endl;
+        }
+        _reloading = false;
+    });
+    return true;
+}
+
+void Searcher::Snapshot::search(const cv::Mat &image, uint numOfResults, std::vector<ResultItem_t> &results) const
+{
+    SSE_TRACE_SCOPE(TraceSearch);
+
+    //extract features
+    KeyPoints_t keypoints;
+    Features_t features;
+    _galif.compute(image, keypoints, features);
+
+    //quantize
+    Vec_f32_t histogram;
+    if(_softQuantizer.numOfNearest() > 1)
+        quantize(features, _vocabulary, histogram, _softQuantizer);
+    else
+        quantize(features, _vocabulary, histogram, _quantizer);
+
+    query(histogram, numOfResults, results);
+}
+
+void Searcher::Snapshot::words(Features_t::ConstRow feature, SparseHist_t &weights) const
+{
+    if(_softQuantizer.numOfNearest() > 1) {
+        _softQuantizer.weights(feature, _vocabulary, weights);
+    }
+    else {
+        weights.assign(1, Term_t(_quantizer.nearest(feature, _vocabulary), 1));
+    }
+}
+
+void Searcher::Snapshot::query(const Vec_f32_t &histogram, uint numOfResults, std::vector<ResultItem_t> &results) const
+{
+    SparseHist_t words;
+    if(_cache) {
+        for(uint i = 0; i < histogram.size(); i++) {
+            if(histogram[i] != 0) words.push_back(Term_t(i, histogram[i]));
+        }
+        if(_cache->getWords(words, numOfResults, results))
+            return;
+    }
+
+    TF_simple tf;
+    IDF_simple idf;
+
+    if(_numOfViews == 1)
+        _index.query(histogram, tf, idf, numOfResults, results);
+    else
+        _index.query(histogram, tf, idf, numOfResults, _numOfViews, results);
+
+    if(_cache)
+        _cache->putWords(words, numOfResults, results);
+}
+
+void Searcher::Snapshot::search(const std::string &filename, uint numOfResults, std::vector<ResultItem_t> &results) const
+{
+    // read the bytes rather than the image, repeated requests then hit the image cache
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if(!in)
+        throw std::runtime_error("can not read image " + filename);
+    std::vector<unsigned char> encoded((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    search(encoded, numOfResults, results);
+}
+
+static cv::Mat decode_image(const std::vector<unsigned char> &encoded)
+{
+    SSE_TRACE_SCOPE(TraceDecode);
+    // Galif only looks at the gray values
+    return cv::imdecode(encoded, cv::IMREAD_GRAYSCALE);
+}
+
+void Searcher::Snapshot::search(const std::vector<unsigned char> &encoded, uint numOfResults, std::vector<ResultItem_t> &results) const
+{
+    if(_cache && _cache->getImage(encoded, numOfResults, results))
+        return;
+
+    cv::Mat image = decode_image(encoded);
+    if(image.empty())
+        throw std::runtime_error("can not decode image");
+
+    search(image, numOfResults, results);
+
+    if(_cache)
+        _cache->putImage(encoded, numOfResults, results);
+}
+
+void Searcher::Snapshot::search(const Strokes_t &strokes, const cv::Size &canvasSize, float penWidth,
+                      uint numOfResults, std::vector<ResultItem_t> &results) const
+{
+    cv::Mat image;
+    rasterizeStrokes(strokes, canvasSize, penWidth, _galif.width(), image);
+
+    search(image, numOfResults, results);
+}
+
+} //namespace sse
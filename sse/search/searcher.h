@@ -0,0 +1,149 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#ifndef SEARCHER_H
+#define SEARCHER_H
+
+#include "../common/types.h"
+#include "../features/galif.h"
+#include "../features/util.h"
+#include "../index/invertedindex.h"
+#include "../io/filelist.h"
+#include "../quantize/quantizer.h"
+#include "querycache.h"
+
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace sse {
+
+/**
+ * @brief Sketch search with everything it needs loaded once
+ *
+ * Loads the index, the vocabulary and the filelist of the indexed images and
+ * answers queries against them. The loaded files form an immutable Snapshot:
+ * search() may be called from any number of threads at the same time, also
+ * while reload() loads the files again. A query runs on the snapshot that was
+ * current when it started, queries started after reload() has published the
+ * new snapshot use that one.
+ */
+class Searcher
+{
+public:
+    class Snapshot
+    {
+    public:
+        // image as loaded by cv::imread, gray or 3 channels, white background
+        void search(const cv::Mat &image, uint numOfResults, std::vector<ResultItem_t> &results) const;
+        // image file, throws std::runtime_error if it can not be read
+        void search(const std::string &filename, uint numOfResults, std::vector<ResultItem_t> &results) const;
+        // encoded image (png, jpg, ...) in memory, throws std::runtime_error if it can not be decoded
+        void search(const std::vector<unsigned char> &encoded, uint numOfResults, std::vector<ResultItem_t> &results) const;
+        // strokes drawn on a canvas of canvasSize with a pen of penWidth canvas pixels,
+        // they are rasterized right at the resolution the features are computed at
+        void search(const Strokes_t &strokes, const cv::Size &canvasSize, float penWidth,
+                    uint numOfResults, std::vector<ResultItem_t> &results) const;
+
+        // bag of visual words of a query, as built by quantize()
+        void query(const Vec_f32_t &histogram, uint numOfResults, std::vector<ResultItem_t> &results) const;
+
+        const FileList& files() const { return _files; }
+        const Galif& galif() const { return _galif; }
+        uint numOfWords() const { return _vocabulary.size(); }
+        // visual words of one feature with their weights, a single word of weight 1 unless
+        // soft quantization is enabled
+        void words(Features_t::ConstRow feature, SparseHist_t &weights) const;
+        // the cache of this snapshot, NULL if not enabled
+        QueryCache* cache() const { return _cache.get(); }
+        // increases with every reload
+        uint64_t version() const { return _version; }
+
+    private:
+        friend class Searcher;
+        Snapshot(const Searcher &searcher, uint64_t version);
+
+        InvertedIndex _index;
+        Vocabularys_t _vocabulary;
+        FileList _files;
+        const Galif &_galif;
+        QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > _quantizer;
+        QuantizerFuzzy<Vec_f32_t, L2norm_squared<Vec_f32_t> > _softQuantizer;
+        const uint _numOfViews;
+        const uint64_t _version;
+        std::unique_ptr<QueryCache> _cache;
+    };
+    typedef std::shared_ptr<const Snapshot> SnapshotPtr_t;
+
+    Searcher(const std::string &indexFile, const std::string &vocabularyFile,
+             const std::string &fileList, uint numOfViews = 1);
+    ~Searcher();
+
+    // Keeps the results of up to capacity recent queries per cache level for ttl (zero: until
+    // evicted), see QueryCache. Every snapshot has its own cache, so a reload starts with an
+    // empty one. Call before searching from several threads.
+    void enableCache(size_t capacity, std::chrono::steady_clock::duration ttl = std::chrono::steady_clock::duration::zero());
+
+    // Quantizes queries softly to the numOfNearest closest words of each feature, see
+    // QuantizerFuzzy, 1 is hard quantization (the default). Use the same as for the index.
+    // Call before searching from several threads.
+    void enableSoftQuantization(uint numOfNearest, float sigma);
+
+    // The current snapshot. Keep it to get results and file names that belong together,
+    // but only for the duration of a query: reload() waits for the last user of the old one.
+    SnapshotPtr_t snapshot() const { return std::atomic_load(&_snapshot); }
+
+    // Loads the files again on the calling thread and publishes them. Queries are not blocked.
+    void reload();
+    // Same on a background thread, returns false if a reload is still running
+    bool reloadInBackground();
+
+    // the same as on snapshot()
+    void search(const cv::Mat &image, uint numOfResults, std::vector<ResultItem_t> &results) const
+    { snapshot()->search(image, numOfResults, results); }
+    void search(const std::string &filename, uint numOfResults, std::vector<ResultItem_t> &results) const
+    { snapshot()->search(filename, numOfResults, results); }
+    void search(const std::vector<unsigned char> &encoded, uint numOfResults, std::vector<ResultItem_t> &results) const
+    { snapshot()->search(encoded, numOfResults, results); }
+    void search(const Strokes_t &strokes, const cv::Size &canvasSize, float penWidth,
+                uint numOfResults, std::vector<ResultItem_t> &results) const
+    { snapshot()->search(strokes, canvasSize, penWidth, numOfResults, results); }
+
+    // the feature extractor, the same in all snapshots
+    const Galif& galif() const { return _galif; }
+
+private:
+    const std::string _indexFile;
+    const std::string _vocabularyFile;
+    const std::string _fileList;
+    const uint _numOfViews;
+    Galif _galif;
+
+    size_t _cacheCapacity;
+    std::chrono::steady_clock::duration _cacheTtl;
+    QuantizerFuzzy<Vec_f32_t, L2norm_squared<Vec_f32_t> > _softQuantizer;
+
+    std::shared_ptr<Snapshot> _snapshot;
+
+    std::mutex _reloadMutex;
+    std::atomic<bool> _reloading;
+    std::thread _reloader;
+};
+
+} //namespace sse
+
+#endif // SEARCHER_H
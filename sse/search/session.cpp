@@ -0,0 +1,114 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include "session.h"
+
+#include <limits>
+#include <cmath>
+
+namespace sse {
+
+static void empty_words(const Searcher::Snapshot &snapshot, SparseHist_t &words)
+{
+    const Galif &galif = snapshot.galif();
+    cv::Mat empty(galif.width(), galif.width(), CV_8UC1, cv::Scalar(255));
+
+    KeyPoints_t keypoints;
+    Features_t features;
+    galif.compute(empty, keypoints, features);
+    const Features_t &zero = features;
+    snapshot.words(zero[0], words);
+}
+
+// adds sign * weights of words to histogram
+static void add_words(const SparseHist_t &words, float sign, Vec_f32_t &histogram)
+{
+    for(uint i = 0; i < words.size(); i++) {
+        float &count = histogram[words[i].first];
+        count += sign * words[i].second;
+        // soft weights do not add up to exactly zero again, a word that is gone must not stay in the query
+        if(std::fabs(count) < 1e-5f) count = 0;
+    }
+}
+
+SketchSession::SketchSession(const Galif &galif)
+    : _galif(galif)
+    , _version(std::numeric_limits<uint64_t>::max()), _numOfFeatures(0)
+{
+}
+
+void SketchSession::reset()
+{
+    _galif.reset();
+    _words.clear();
+}
+
+void SketchSession::search(const Searcher::Snapshot &snapshot, const cv::Mat &image,
+                           uint numOfResults, std::vector<ResultItem_t> &results)
+{
+    _galif.compute(image, _changed);
+
+    // a new canvas size has other samples (usually as many as before, at other
+    // positions), and after a reload the words mean something else: assign the
+    // words of all samples again
+    const uint numSamples = _galif.features().size();
+    if(snapshot.version() != _version || _galif.size() != _size || _words.size() != numSamples) {
+        _version = snapshot.version();
+        _size = _galif.size();
+        empty_words(snapshot, _emptyWords);
+        _words.assign(numSamples, SparseHist_t());
+        _histogram.assign(snapshot.numOfWords(), 0);
+        _numOfFeatures = 0;
+        _changed.resize(numSamples);
+        for(uint i = 0; i < numSamples; i++) _changed[i] = i;
+    }
+
+    SparseHist_t words;
+    for(uint i = 0; i < _changed.size(); i++) {
+        uint sample = _changed[i];
+        if(_galif.isEmpty(sample)) words.clear();
+        else snapshot.words(_galif.features()[sample], words);
+        if(words == _words[sample]) continue;
+
+        if(!_words[sample].empty()) {
+            add_words(_words[sample], -1, _histogram);
+            _numOfFeatures--;
+        }
+        if(!words.empty()) {
+            add_words(words, 1, _histogram);
+            _numOfFeatures++;
+        }
+        _words[sample].swap(words);
+    }
+
+    if(_numOfFeatures > 0) {
+        snapshot.query(_histogram, numOfResults, results);
+    }
+    else {
+        Vec_f32_t empty(snapshot.numOfWords(), 0);
+        add_words(_emptyWords, 1, empty);
+        snapshot.query(empty, numOfResults, results);
+    }
+}
+
+void SketchSession::search(const Searcher::Snapshot &snapshot, const Strokes_t &strokes, const cv::Size &canvasSize, float penWidth,
+                           uint numOfResults, std::vector<ResultItem_t> &results)
+{
+    rasterizeStrokes(strokes, canvasSize, penWidth, snapshot.galif().width(), _image);
+    search(snapshot, _image, numOfResults, results);
+}
+
+} //namespace sse
@@ -0,0 +1,73 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "searcher.h"
+
+namespace sse {
+
+/**
+ * @brief Search for a sketch while it is being drawn
+ *
+ * Keeps the features and visual words of the previous version of the sketch.
+ * Each search only recomputes the features around what changed since (see
+ * IncrementalGalif) and updates the bag of visual words by the words that
+ * changed, so the latency of a search stays flat as the sketch grows. The
+ * results equal those of Searcher::search for the same image, up to the
+ * approximations described at IncrementalGalif.
+ *
+ * When the snapshot changes (see Searcher::reload) the words of all samples
+ * are assigned again.
+ *
+ * Holds a reference to galif. Not thread safe, use one session per sketch.
+ */
+class SketchSession
+{
+public:
+    SketchSession(const Galif &galif);
+
+    // starts over with an empty sketch
+    void reset();
+
+    // the whole sketch after the latest change, searched in snapshot (of a Searcher using the same Galif)
+    void search(const Searcher::Snapshot &snapshot, const cv::Mat &image,
+                uint numOfResults, std::vector<ResultItem_t> &results);
+    void search(const Searcher::Snapshot &snapshot, const Strokes_t &strokes, const cv::Size &canvasSize, float penWidth,
+                uint numOfResults, std::vector<ResultItem_t> &results);
+
+private:
+    IncrementalGalif _galif;
+
+    // version of the snapshot and scaled image size the words below belong to
+    uint64_t _version;
+    cv::Size _size;
+    // visual words of each sample with their weights, none if the sample is empty
+    std::vector<SparseHist_t> _words;
+    // histogram of the words of the non empty samples
+    Vec_f32_t _histogram;
+    uint _numOfFeatures;
+    // Galif::compute describes a sketch without any strokes by a single all zero feature
+    SparseHist_t _emptyWords;
+
+    std::vector<uint> _changed;
+    cv::Mat _image;
+};
+
+} //namespace sse
+
+#endif // SESSION_H
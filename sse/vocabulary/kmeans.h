@@ -31,6 +31,28 @@
 
 namespace sse {
 
+/**
+ * @brief Assignment step of Kmeans, finds the nearest center of one sample.
+ *
+ * The default compares samples and centers with the exact distance function.
+ * Compressed sample stores specialize it (see sample_store.h).
+ */
+template <class collection_t, class dist_fn>
+struct KmeansAssign
+{
+    typedef typename collection_t::value_type sample_t;
+
+    // Called once per iteration, before any call to nearest()
+    void prepare(const collection_t& /*collection*/, const std::vector<sample_t>& /*centers*/) {}
+
+    std::size_t nearest(const collection_t& collection, std::size_t i, const std::vector<sample_t>& centers,
+                        const dist_fn& distfn, std::vector<double>& dists) const
+    {
+        for (std::size_t k = 0; k < centers.size(); k++) dists[k] = distfn(centers[k], collection[i]);
+        return std::distance(dists.begin(), std::min_element(dists.begin(), dists.end()));
+    }
+};
+
 /**
  * @brief Standard kmeans clustering
  */
@@ -51,19 +73,21 @@ public:
      * @param numclusters Number of clusters to use.
      * @param initalgorithm Algorithm used to estimate the inital cluster centers
      * @param distfn Distance function used for comparing two samples.
+     * @param seed Seed for the initialization, the same seed always gives the same clustering.
      */
-    Kmeans(const collection_t& collection, std::size_t numclusters, KmeansInitAlgorithm initalgorithm = KmeansInitRandom, const dist_fn& distfn = dist_fn())
-     : _collection(collection), _distfn(distfn), _centers(numclusters), _clusters(collection.size())
+    Kmeans(const collection_t& collection, std::size_t numclusters, KmeansInitAlgorithm initalgorithm = KmeansInitRandom, const dist_fn& distfn = dist_fn(),
+           unsigned int seed = DefaultSeed)
+     : _collection(collection), _distfn(distfn), _centers(numclusters), _clusters(collection.size()), _refineoffset(0)
     {
         // get initial centers
         std::vector<std::size_t> initindices;
         if (initalgorithm == KmeansInitPlusPlus)
         {
-            kmeans_init_plusplus(initindices, collection, numclusters, distfn);
+            kmeans_init_plusplus(initindices, collection, numclusters, distfn, seed);
         }
         else
         {
-            kmeans_init_random(initindices, collection, numclusters);
+            kmeans_init_random(initindices, collection, numclusters, seed);
         }
 
         for (std::size_t i = 0; i < initindices.size(); i++) _centers[i] = collection[initindices[i]];
@@ -88,6 +112,8 @@ public:
 
             std::size_t changes = 0;
 
+            _assign.prepare(_collection, _centers);
+
             // distribute items on clusters in parallel
             std::vector<std::thread> pools(std::thread::hardware_concurrency());
 
@@ -194,6 +220,70 @@ public:
         this->run(std::numeric_limits<std::size_t>::max(), 0.01);
     }
 
+    /**
+     * @brief Refine the centers on exact samples
+     *
+     * If the collection only approximates the samples (see sample_store.h), the
+     * centers found by run() are refined by one more Lloyd step on the exact data.
+     * Pass all exact samples, in the same order as in the collection and in as many
+     * chunks as you like, to refine() and then call finish_refinement(). Only
+     * one chunk has to be held in memory at a time.
+     */
+    template <class samples_t>
+    void refine(const samples_t& samples)
+    {
+        if (_refinesums.empty())
+        {
+            _refinesums.assign(_centers.size(), std::vector<double>(_centers[0].size(), 0.0));
+            _refinecounts.assign(_centers.size(), 0);
+            _refineoffset = 0;
+        }
+
+        // find the nearest centers in parallel ...
+        std::vector<std::size_t> nearest(samples.size());
+        std::size_t numthreads = std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::thread> pools;
+        for (std::size_t t = 0; t < numthreads; t++)
+        {
+            pools.push_back(std::thread([&, t]()
+            {
+                std::vector<double> dists(_centers.size());
+                for (std::size_t i = t; i < samples.size(); i += numthreads)
+                {
+                    for (std::size_t k = 0; k < _centers.size(); k++) dists[k] = _distfn(_centers[k], samples[i]);
+                    nearest[i] = std::distance(dists.begin(), std::min_element(dists.begin(), dists.end()));
+                }
+            }));
+        }
+        for (std::size_t t = 0; t < numthreads; t++) pools[t].join();
+
+        // ... but accumulate in order, so that the result does not depend on scheduling
+        for (std::size_t i = 0; i < samples.size(); i++)
+        {
+            std::size_t c = nearest[i];
+            for (std::size_t j = 0; j < samples[i].size(); j++) _refinesums[c][j] += samples[i][j];
+            _refinecounts[c]++;
+
+            if (_refineoffset + i < _clusters.size()) _clusters[_refineoffset + i] = c;
+        }
+        _refineoffset += samples.size();
+    }
+
+    void finish_refinement()
+    {
+        for (std::size_t c = 0; c < _refinesums.size(); c++)
+        {
+            // keep centers that got no exact sample
+            if (_refinecounts[c] == 0) continue;
+
+            for (std::size_t j = 0; j < _centers[c].size(); j++)
+                _centers[c][j] = _refinesums[c][j] / _refinecounts[c];
+        }
+
+        _refinesums.clear();
+        _refinecounts.clear();
+    }
+
     // Vector of cluster membership: clusters[i] = j means that the sample with index i
     // is a member of cluster j
     const std::vector<std::size_t>& clusters() const
@@ -217,8 +307,8 @@ public:
         for (std::size_t i = 0; i < _clusters.size(); i++) table[_clusters[i]].push_back(i);
     }
 
-    template <class T>
-    static void add_operation(T& lhs, const T& rhs)
+    template <class T, class U>
+    static void add_operation(T& lhs, const U& rhs)
     {
         for (std::size_t i = 0; i < lhs.size(); i++) lhs[i] += rhs[i];
     }
@@ -246,13 +336,9 @@ private:
                 i = index++;
             }
 
-            // compute distance of current point to every center
-            // std::cout <<endl << "collection[" << i << "]=" << _collection[i].size() << " " << _centers.size() <<endl;
-            std::vector<Vec_f32_t> collections(_centers.size(), _collection[i]);
-            std::transform(_centers.begin(), _centers.end(), collections.begin(), dists.begin(), _distfn);
-
+            // compute distance of current point to every center and
             // find the minimum distance, i.e. the nearest center
-            std::size_t c = std::distance(dists.begin(), std::min_element(dists.begin(), dists.end()));
+            std::size_t c = _assign.nearest(_collection, i, _centers, _distfn, dists);
 
             // update cluster membership
             {
@@ -273,11 +359,17 @@ private:
     }
 
     const collection_t& _collection;
-    const dist_fn&      _distfn;
+    const dist_fn       _distfn;
 
     std::vector<sample_t>    _centers;
     std::vector<std::size_t> _clusters;
 
+    KmeansAssign<collection_t, dist_fn> _assign;
+
+    std::vector<std::vector<double> > _refinesums;
+    std::vector<std::size_t>          _refinecounts;
+    std::size_t                       _refineoffset;
+
     mutex_t        _mutex;
 };
 
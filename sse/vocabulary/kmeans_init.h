@@ -19,38 +19,41 @@
 
 #include "../common/types.h"
 #include "../common/distance.h"
+#include "../common/random.h"
 
 #include <algorithm>
-#include <random>
 
 namespace sse {
 
 template <class index_t, class collection_t>
-void kmeans_init_random(std::vector<index_t>& centers, const collection_t& collection, std::size_t numclusters)
+void kmeans_init_random(std::vector<index_t>& centers, const collection_t& collection, std::size_t numclusters,
+                        unsigned int seed = DefaultSeed)
 {
     assert(collection.size() >= numclusters);
 
+    Rng_t generator = make_rng(seed);
+
     centers.resize(collection.size());
     for (std::size_t i = 0; i < centers.size(); i++) centers[i] = i;
-    std::random_shuffle(centers.begin(), centers.end());
+    fisher_yates_shuffle(centers.begin(), centers.end(), generator);
     centers.resize(numclusters);
 }
 
 template <class index_t, class collection_t, class dist_fn>
-void kmeans_init_plusplus(std::vector<index_t>& result, const collection_t& collection, std::size_t numclusters, const dist_fn& distfn)
+void kmeans_init_plusplus(std::vector<index_t>& result, const collection_t& collection, std::size_t numclusters, const dist_fn& distfn,
+                          unsigned int seed = DefaultSeed)
 {
     assert(numclusters > 0);
     assert(collection.size() >= numclusters);
 
-    std::random_device rd;  // will be used to obtain a seed for the random number engine
-    std::mt19937 generator(rd()); // standard mersenne_twister_engine seeded with rd()
-    std::uniform_real_distribution<> unirand(0.0, 1.0);
+    // same seed, same centers
+    Rng_t generator = make_rng(seed);
 
     std::size_t numtrials = 2 + std::log(numclusters);
 
     // add first cluster, randomly chosen
     std::set<index_t> centers;
-    index_t first = unirand(generator) * collection.size();
+    index_t first = random_index(generator, collection.size());
     centers.insert(first);
 
     // compute distance between first cluster center and all others
@@ -76,7 +79,7 @@ void kmeans_init_plusplus(std::vector<index_t>& result, const collection_t& coll
             std::size_t index;
 
             // get new center
-            double r = unirand(generator) * potential;
+            double r = random_uniform(generator) * potential;
             for (index = 0; index < collection.size()-1 && r > dists[index]; index++)
             {
                 r -= dists[index];
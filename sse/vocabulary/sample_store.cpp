@@ -0,0 +1,220 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include "sample_store.h"
+
+namespace sse {
+
+SampleStore::SampleStore()
+    : _dim(0), _codeSize(0), _size(0)
+{
+}
+
+SampleStore::~SampleStore()
+{
+}
+
+void SampleStore::add(const Vec_f32_t &sample)
+{
+    assert(_codeSize > 0); // train() first
+    assert(sample.size() == _dim);
+
+    _codes.resize(_codes.size() + _codeSize);
+    encode(sample.data(), &_codes[_size * _codeSize]);
+    _size++;
+}
+
+void SampleStore::add(const Features_t &samples)
+{
+    assert(_codeSize > 0); // train() first
+    assert(samples.empty() || samples.cols() == _dim);
+
+    _codes.resize(_codes.size() + samples.size() * _codeSize);
+    for (size_t i = 0; i < samples.size(); i++) {
+        encode(samples.row(i), &_codes[_size * _codeSize]);
+        _size++;
+    }
+}
+
+Vec_f32_t SampleStore::operator[](std::size_t i) const
+{
+    Vec_f32_t sample(_dim);
+    decode(i, &sample[0]);
+    return sample;
+}
+
+void SampleStoreSQ8::train(const Features_t &samples, uint /*seed*/)
+{
+    assert(samples.size() > 0);
+
+    _dim = samples.cols();
+    _codeSize = _dim;
+
+    _min.assign(_dim, std::numeric_limits<float>::max());
+    Vec_f32_t max(_dim, -std::numeric_limits<float>::max());
+    for (size_t i = 0; i < samples.size(); i++) {
+        for (uint d = 0; d < _dim; d++) {
+            _min[d] = std::min(_min[d], samples.row(i)[d]);
+            max[d] = std::max(max[d], samples.row(i)[d]);
+        }
+    }
+
+    _step.resize(_dim);
+    for (uint d = 0; d < _dim; d++) {
+        _step[d] = (max[d] - _min[d]) / 255.0f;
+        // constant dimension, every sample gets code 0
+        if (_step[d] <= 0) _step[d] = 1.0f;
+    }
+}
+
+void SampleStoreSQ8::encode(const float *sample, unsigned char *code) const
+{
+    for (uint d = 0; d < _dim; d++) {
+        float q = (sample[d] - _min[d]) / _step[d] + 0.5f;
+        // samples outside of the training range are clamped
+        code[d] = static_cast<unsigned char>(std::min(255.0f, std::max(0.0f, q)));
+    }
+}
+
+void SampleStoreSQ8::decode(std::size_t i, float *sample) const
+{
+    const unsigned char *c = code(i);
+    for (uint d = 0; d < _dim; d++) {
+        sample[d] = _min[d] + _step[d] * c[d];
+    }
+}
+
+void SampleStoreSQ8::distances(std::size_t i, const Vocabularys_t &centers, std::vector<double> &dists) const
+{
+    Vec_f32_t sample(_dim);
+    decode(i, &sample[0]);
+
+    L2norm_squared<Vec_f32_t> dist;
+    for (size_t k = 0; k < centers.size(); k++) {
+        dists[k] = dist(centers[k], sample);
+    }
+}
+
+const uint SampleStorePQ::NumCentroids;
+
+SampleStorePQ::SampleStorePQ(uint numSubspaces)
+    : _numSubspaces(numSubspaces), _subDim(0)
+{
+}
+
+void SampleStorePQ::train(const Features_t &samples, uint seed)
+{
+    assert(samples.size() > 0);
+
+    _dim = samples.cols();
+    if (_numSubspaces == 0) _numSubspaces = std::max(1u, _dim / 4);
+    assert(_dim % _numSubspaces == 0);
+
+    _subDim = _dim / _numSubspaces;
+    _codeSize = _numSubspaces;
+
+    uint numCentroids = std::min<size_t>(NumCentroids, samples.size());
+
+    _centroids.resize(_numSubspaces);
+    for (uint m = 0; m < _numSubspaces; m++) {
+        Features_t parts(samples.size(), _subDim);
+        for (size_t i = 0; i < samples.size(); i++) {
+            const float *part = samples.row(i) + m*_subDim;
+            std::copy(part, part + _subDim, parts.row(i));
+        }
+
+        // every subspace gets its own random stream
+        Rng_t generator = make_rng(seed, m);
+        Kmeans<Features_t, L2norm_squared<Vec_f32_t> > cluster(parts, numCentroids, KmeansInitRandom,
+                                                               L2norm_squared<Vec_f32_t>(), generator());
+        cluster.run(25, 0.01);
+
+        _centroids[m] = cluster.centers();
+        // fewer samples than centroids, the unused codes repeat the last centroid
+        _centroids[m].resize(NumCentroids, _centroids[m].back());
+    }
+}
+
+void SampleStorePQ::encode(const float *sample, unsigned char *code) const
+{
+    for (uint m = 0; m < _numSubspaces; m++) {
+        const float *part = &sample[m * _subDim];
+
+        uint closest = 0;
+        float minDistance = std::numeric_limits<float>::max();
+        for (uint k = 0; k < NumCentroids; k++) {
+            const Vec_f32_t &centroid = _centroids[m][k];
+            float distance = 0;
+            for (uint d = 0; d < _subDim; d++) {
+                float diff = part[d] - centroid[d];
+                distance += diff * diff;
+            }
+            if (distance < minDistance) {
+                closest = k;
+                minDistance = distance;
+            }
+        }
+        code[m] = static_cast<unsigned char>(closest);
+    }
+}
+
+void SampleStorePQ::decode(std::size_t i, float *sample) const
+{
+    const unsigned char *c = code(i);
+    for (uint m = 0; m < _numSubspaces; m++) {
+        const Vec_f32_t &centroid = _centroids[m][c[m]];
+        std::copy(centroid.begin(), centroid.end(), sample + m * _subDim);
+    }
+}
+
+void SampleStorePQ::distanceTable(const Vocabularys_t &centers, Vec_f32_t &table) const
+{
+    table.resize(centers.size() * _numSubspaces * NumCentroids);
+
+    for (size_t c = 0; c < centers.size(); c++) {
+        assert(centers[c].size() == _dim);
+        for (uint m = 0; m < _numSubspaces; m++) {
+            const float *part = &centers[c][m * _subDim];
+            float *row = &table[(c * _numSubspaces + m) * NumCentroids];
+            for (uint k = 0; k < NumCentroids; k++) {
+                const Vec_f32_t &centroid = _centroids[m][k];
+                float distance = 0;
+                for (uint d = 0; d < _subDim; d++) {
+                    float diff = part[d] - centroid[d];
+                    distance += diff * diff;
+                }
+                row[k] = distance;
+            }
+        }
+    }
+}
+
+void SampleStorePQ::distances(std::size_t i, const Vec_f32_t &table, std::vector<double> &dists) const
+{
+    const unsigned char *c = code(i);
+    const size_t numCenters = table.size() / (_numSubspaces * NumCentroids);
+    const float *row = &table[0];
+
+    for (size_t k = 0; k < numCenters; k++) {
+        float distance = 0;
+        for (uint m = 0; m < _numSubspaces; m++, row += NumCentroids) {
+            distance += row[c[m]];
+        }
+        dists[k] = distance;
+    }
+}
+
+} //namespace sse
@@ -0,0 +1,178 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#ifndef SAMPLE_STORE_H
+#define SAMPLE_STORE_H
+
+#include "../common/types.h"
+#include "kmeans.h"
+
+namespace sse {
+
+/**
+ * @brief Compact storage of training samples for Kmeans
+ *
+ * Raw Galif descriptors take 4 bytes per dimension, which limits the number
+ * of sketches we can cluster at once. A sample store keeps only a compressed code
+ * per sample and can be passed to Kmeans in place of a Features_t:
+ *
+ *   SampleStorePQ store;
+ *   store.train(subset, seed);
+ *   store.add(features);        // for each image
+ *   Kmeans<SampleStorePQ, L2norm_squared<Vec_f32_t> > cluster(store, numclusters);
+ *   cluster.run(maxiter, minChangesfraction);
+ *   cluster.refine(exact);      // optional, for each chunk of exact samples
+ *   cluster.finish_refinement();
+ *
+ * Samples are compared by squared L2 distance against the compressed codes,
+ * operator[] returns the decoded (approximate) sample.
+ */
+class SampleStore
+{
+public:
+    typedef Vec_f32_t value_type;
+
+    SampleStore();
+    virtual ~SampleStore();
+
+    // Learn the code from a (random) subset of the samples, must be called before add()
+    virtual void train(const Features_t &samples, uint seed = DefaultSeed) = 0;
+
+    void add(const Vec_f32_t &sample);
+    void add(const Features_t &samples);
+
+    // Decoded sample i
+    Vec_f32_t operator[](std::size_t i) const;
+    virtual void decode(std::size_t i, float *sample) const = 0;
+
+    std::size_t size() const { return _size; }
+    uint dim() const { return _dim; }
+    // bytes per sample
+    uint codeSize() const { return _codeSize; }
+    // bytes used by all codes
+    std::size_t memory() const { return _codes.size(); }
+
+protected:
+    virtual void encode(const float *sample, unsigned char *code) const = 0;
+    const unsigned char* code(std::size_t i) const { return &_codes[i * _codeSize]; }
+
+    uint _dim;
+    uint _codeSize;
+    std::size_t _size;
+    std::vector<unsigned char> _codes;
+};
+
+/**
+ * @brief 8-bit scalar quantization, one byte per dimension (4x smaller)
+ *
+ * Each dimension is quantized uniformly between its minimum and maximum over
+ * the training samples.
+ */
+class SampleStoreSQ8 : public SampleStore
+{
+public:
+    void train(const Features_t &samples, uint seed = DefaultSeed);
+    void decode(std::size_t i, float *sample) const;
+
+    // squared L2 distances of sample i to all centers
+    void distances(std::size_t i, const Vocabularys_t &centers, std::vector<double> &dists) const;
+
+protected:
+    void encode(const float *sample, unsigned char *code) const;
+
+private:
+    Vec_f32_t _min;
+    Vec_f32_t _step;
+};
+
+/**
+ * @brief Product quantization, one byte per subspace
+ *
+ * The sample is split into numSubspaces parts and each part is replaced by the
+ * index of its nearest centroid among 256 (trained with Kmeans). With the
+ * default of 4 dimensions per subspace a 64-float Galif descriptor takes 16
+ * bytes (16x smaller).
+ *
+ * Distances to the Kmeans centers are looked up in a table that holds, for each
+ * center and subspace, the distance of the center's part to all 256 centroids
+ * (asymmetric distance computation, see Jegou et al. - Product quantization
+ * for nearest neighbor search).
+ */
+class SampleStorePQ : public SampleStore
+{
+public:
+    // numSubspaces = 0 picks dim/4 on train()
+    SampleStorePQ(uint numSubspaces = 0);
+
+    void train(const Features_t &samples, uint seed = DefaultSeed);
+    void decode(std::size_t i, float *sample) const;
+
+    // table[(c*numSubspaces + m)*256 + k]: squared L2 distance of part m of center c to centroid k
+    void distanceTable(const Vocabularys_t &centers, Vec_f32_t &table) const;
+    // squared L2 distances of sample i to all centers, using the table above
+    void distances(std::size_t i, const Vec_f32_t &table, std::vector<double> &dists) const;
+
+    uint numSubspaces() const { return _numSubspaces; }
+
+protected:
+    void encode(const float *sample, unsigned char *code) const;
+
+private:
+    static const uint NumCentroids = 256;
+
+    uint _numSubspaces;
+    uint _subDim;
+    // _centroids[m][k]: centroid k of subspace m
+    std::vector<Vocabularys_t> _centroids;
+};
+
+/**
+ * Kmeans assignment on compressed samples, all stores assume squared L2 distances
+ */
+template <class dist_fn>
+struct KmeansAssign<SampleStoreSQ8, dist_fn>
+{
+    void prepare(const SampleStoreSQ8& /*collection*/, const Vocabularys_t& /*centers*/) {}
+
+    std::size_t nearest(const SampleStoreSQ8& collection, std::size_t i, const Vocabularys_t& centers,
+                        const dist_fn& /*distfn*/, std::vector<double>& dists) const
+    {
+        collection.distances(i, centers, dists);
+        return std::distance(dists.begin(), std::min_element(dists.begin(), dists.end()));
+    }
+};
+
+template <class dist_fn>
+struct KmeansAssign<SampleStorePQ, dist_fn>
+{
+    void prepare(const SampleStorePQ& collection, const Vocabularys_t& centers)
+    {
+        collection.distanceTable(centers, _table);
+    }
+
+    std::size_t nearest(const SampleStorePQ& collection, std::size_t i, const Vocabularys_t& /*centers*/,
+                        const dist_fn& /*distfn*/, std::vector<double>& dists) const
+    {
+        collection.distances(i, _table, dists);
+        return std::distance(dists.begin(), std::min_element(dists.begin(), dists.end()));
+    }
+
+    Vec_f32_t _table;
+};
+
+} //namespace sse
+
+#endif // SAMPLE_STORE_H
@@ -0,0 +1,364 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+using namespace std;
+
+#include "opensse/opensse.h"
+
+using namespace sse;
+
+void usages() {
+    cout << "Usages: sse evaluate -i indexfile -v vocabulary -f filelist -q queries [-m mode]... [-n results] [-k ranks]" <<endl
+         << "                     [-w views] [-d depth] [-j threads] [-o output]" <<endl
+         << "  This command measures retrieval quality (mAP, precision@k, nDCG) and speed of search modes" <<endl
+         << "  The label of an image is the name of the directory it is in, queries are relevant to the" <<endl
+         << "  indexed images of their label. The first mode is the baseline the others are compared to." <<endl
+         << "  The options are as follows:" <<endl
+         << "  -i\t inverted index file" <<endl
+         << "  -v\t \033[4mvocabulary\033[0m file" <<endl
+         << "  -f\t \033[4mfilelist\033[0m of the indexed images" <<endl
+         << "  -q\t filelist of the \033[4mqueries\033[0m" <<endl
+         << "  -m\t comma separated key=value options of Galif and the quantizer, may be repeated, default: the" <<endl
+         << "    \t library defaults. engine=fft|spatial|auto smooth=gaussian|recursive|boxes crop=0|1" <<endl
+         << "    \t nearest=words (soft quantization if > 1, as the index was built) sigma=weights" <<endl
+         << "  -n\t number of results per query, ranks below are not evaluated, default: 100" <<endl
+         << "  -k\t comma separated ranks of precision@k, default: 1,5,10" <<endl
+         << "  -w\t number of views per model, results are models if > 1, default: 1" <<endl
+         << "  -d\t the label is the name of the depth-th directory above the file, default: 1" <<endl
+         << "  -j\t number of threads, default: number of cores" <<endl
+         << "  -o\t also write the results to \033[4moutput\033[0m as JSON" <<endl;
+}
+
+// Galif and quantizer options a mode changes, everything else is the library default
+struct Mode
+{
+    string name;
+    string engine;
+    string smooth;
+    bool crop;
+    uint numOfNearest;
+    float sigma;
+
+    Mode() : name("default"), engine("fft"), smooth("gaussian"), crop(false), numOfNearest(1), sigma(0.2) {}
+};
+
+bool parseMode(const string &spec, Mode &mode)
+{
+    mode = Mode();
+    mode.name = spec;
+    stringstream options(spec);
+    for(string option; getline(options, option, ',');) {
+        size_t equals = option.find('=');
+        if(equals == string::npos) return false;
+        string key = option.substr(0, equals), value = option.substr(equals + 1);
+        if(key == "engine" && (value == "fft" || value == "spatial" || value == "auto")) mode.engine = value;
+        else if(key == "smooth" && (value == "gaussian" || value == "recursive" || value == "boxes")) mode.smooth = value;
+        else if(key == "crop" && (value == "0" || value == "1")) mode.crop = value == "1";
+        else if(key == "nearest" && atoi(value.c_str()) > 0) mode.numOfNearest = atoi(value.c_str());
+        else if(key == "sigma" && atof(value.c_str()) > 0) mode.sigma = atof(value.c_str());
+        else return false;
+    }
+    return true;
+}
+
+// name of the depth-th directory above path
+string labelOf(const string &path, uint depth)
+{
+    size_t end = path.rfind('/');
+    for(uint d = 1; d < depth && end != string::npos && end > 0; d++) end = path.rfind('/', end - 1);
+    if(end == string::npos || end == 0) return "";
+    size_t begin = path.rfind('/', end - 1);
+    begin = begin == string::npos ? 0 : begin + 1;
+    return path.substr(begin, end - begin);
+}
+
+struct Quality
+{
+    double averagePrecision;
+    vector<double> precision;
+    double ndcg;
+};
+
+// binary relevance of a ranked list, relevant: number of relevant models in the index
+Quality evaluate(const vector<bool> &hits, uint relevant, const vector<uint> &ranks, uint numOfResults)
+{
+    Quality q;
+    q.averagePrecision = 0;
+    q.ndcg = 0;
+
+    double dcg = 0, idcg = 0;
+    uint found = 0;
+    for(uint r = 0; r < hits.size(); r++) {
+        if(!hits[r]) continue;
+        found++;
+        q.averagePrecision += static_cast<double>(found) / (r + 1);
+        dcg += 1.0 / std::log2(r + 2.0);
+    }
+    // ranks below numOfResults are not retrieved, the ideal list is cut there as well
+    uint ideal = std::min(relevant, numOfResults);
+    for(uint r = 0; r < ideal; r++) idcg += 1.0 / std::log2(r + 2.0);
+    if(ideal > 0) {
+        q.averagePrecision /= ideal;
+        q.ndcg = dcg / idcg;
+    }
+
+    for(size_t k = 0; k < ranks.size(); k++) {
+        uint n = 0;
+        for(uint r = 0; r < std::min<size_t>(ranks[k], hits.size()); r++) n += hits[r];
+        q.precision.push_back(static_cast<double>(n) / ranks[k]);
+    }
+    return q;
+}
+
+// fraction of the first k results of baseline that are also among the first k of results
+double overlap(const vector<ResultItem_t> &results, const vector<ResultItem_t> &baseline, uint k)
+{
+    set<Index_t> expected;
+    for(uint r = 0; r < std::min<size_t>(k, baseline.size()); r++) expected.insert(baseline[r].second);
+    if(expected.empty()) return 1;
+
+    uint n = 0;
+    for(uint r = 0; r < std::min<size_t>(k, results.size()); r++) n += expected.count(results[r].second);
+    return static_cast<double>(n) / expected.size();
+}
+
+struct ModeResult
+{
+    double map;
+    vector<double> precision;
+    double ndcg;
+    double overlap;
+    double meanMs;
+    double p50Ms;
+    double p99Ms;
+    double qps;
+};
+
+int main(int argc, char *argv[])
+{
+    if(argc < 9 || argc % 2 == 0) {
+        usages();
+        exit(1);
+    }
+
+    string indexFile, vocabularyFile, filelist, queryList, outputFile;
+    vector<string> modeSpecs;
+    string rankList = "1,5,10";
+    uint numOfResults = 100;
+    uint numOfViews = 1;
+    uint depth = 1;
+    uint numThreads = std::max(1u, std::thread::hardware_concurrency());
+    for(int i = 1; i < argc; i += 2) {
+        if(!strcmp(argv[i], "-i")) indexFile = argv[i+1];
+        else if(!strcmp(argv[i], "-v")) vocabularyFile = argv[i+1];
+        else if(!strcmp(argv[i], "-f")) filelist = argv[i+1];
+        else if(!strcmp(argv[i], "-q")) queryList = argv[i+1];
+        else if(!strcmp(argv[i], "-m")) modeSpecs.push_back(argv[i+1]);
+        else if(!strcmp(argv[i], "-n")) numOfResults = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-k")) rankList = argv[i+1];
+        else if(!strcmp(argv[i], "-w")) numOfViews = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-d")) depth = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-j")) numThreads = std::max(1, atoi(argv[i+1]));
+        else if(!strcmp(argv[i], "-o")) outputFile = argv[i+1];
+        else {
+            usages();
+            exit(1);
+        }
+    }
+
+    vector<Mode> modes(std::max<size_t>(1, modeSpecs.size()));
+    for(size_t m = 0; m < modeSpecs.size(); m++) {
+        if(!parseMode(modeSpecs[m], modes[m])) {
+            cerr << "invalid mode " << modeSpecs[m] <<endl;
+            exit(1);
+        }
+    }
+
+    vector<uint> ranks;
+    stringstream rankStream(rankList);
+    for(string rank; getline(rankStream, rank, ',');) {
+        if(atoi(rank.c_str()) > 0) ranks.push_back(atoi(rank.c_str()));
+    }
+
+    if(indexFile.empty() || vocabularyFile.empty() || filelist.empty() || queryList.empty()
+            || numOfResults == 0 || numOfViews == 0 || depth == 0 || ranks.empty()) {
+        usages();
+        exit(1);
+    }
+
+    InvertedIndex index;
+    index.load(indexFile);
+    Vocabularys_t vocabulary;
+    read(vocabularyFile, vocabulary, print, "read vocabulary");
+    FileList files, queries;
+    files.load(filelist);
+    queries.load(queryList);
+
+    // labels as ids, and the number of indexed models of each
+    map<string, uint> labelIds;
+    vector<uint> documentLabels(files.size());
+    for(uint i = 0; i < files.size(); i++) {
+        string label = labelOf(files.getFilename(i), depth);
+        documentLabels[i] = labelIds.insert(make_pair(label, labelIds.size())).first->second;
+    }
+    vector<uint> relevant(labelIds.size(), 0);
+    for(uint i = 0; i < files.size(); i += numOfViews) relevant[documentLabels[i]]++;
+
+    vector<int> queryLabels(queries.size());
+    for(uint i = 0; i < queries.size(); i++) {
+        map<string, uint>::const_iterator it = labelIds.find(labelOf(queries.getFilename(i), depth));
+        queryLabels[i] = it == labelIds.end() ? -1 : static_cast<int>(it->second);
+    }
+
+    // decoded once, the modes only differ in what follows
+    vector<cv::Mat> images(queries.size());
+    {
+        DatasetReader reader(queries, 256, numThreads);
+        uint i;
+        cv::Mat image;
+        while(reader.next(i, image)) {
+            if(image.empty()) cerr << "can not read " << queries.getFilename(i) <<endl;
+            images[i] = image;
+        }
+    }
+
+    TF_simple tf;
+    IDF_simple idf;
+    QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > quantizer;
+
+    vector<vector<vector<ResultItem_t> > > results(modes.size(), vector<vector<ResultItem_t> >(queries.size()));
+    vector<ModeResult> summary(modes.size());
+    for(size_t m = 0; m < modes.size(); m++) {
+        const Mode &mode = modes[m];
+        const Galif galif(256, 4, 4, 0.1, 0.02, 0.3, 0.1, true, "l2", "stroke", 625,
+                          mode.smooth, mode.crop, mode.engine);
+        const QuantizerFuzzy<Vec_f32_t, L2norm_squared<Vec_f32_t> > softQuantizer(mode.sigma, mode.numOfNearest);
+
+        // the first call builds the filter bank
+        if(!images.empty() && !images[0].empty()) {
+            KeyPoints_t keypoints;
+            Features_t features;
+            galif.compute(images[0], keypoints, features);
+        }
+
+        vector<double> latencies(queries.size(), 0);
+        std::atomic<uint> next(0);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        std::vector<std::thread> pools;
+        for(uint t = 0; t < numThreads; t++) {
+            pools.push_back(std::thread([&]() {
+                KeyPoints_t keypoints;
+                Features_t features;
+                Vec_f32_t histogram;
+                for(uint i = next++; i < queries.size(); i = next++) {
+                    if(images[i].empty()) continue;
+                    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+                    galif.compute(images[i], keypoints, features);
+                    if(mode.numOfNearest > 1)
+                        quantize(features, vocabulary, histogram, softQuantizer);
+                    else
+                        quantize(features, vocabulary, histogram, quantizer);
+                    if(numOfViews == 1)
+                        index.query(histogram, tf, idf, numOfResults, results[m][i]);
+                    else
+                        index.query(histogram, tf, idf, numOfResults, numOfViews, results[m][i]);
+                    latencies[i] = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+                }
+            }));
+        }
+        for(uint t = 0; t < numThreads; t++) pools[t].join();
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        ModeResult &s = summary[m];
+        s.map = s.ndcg = s.overlap = 0;
+        s.precision.assign(ranks.size(), 0);
+        uint evaluated = 0;
+        vector<double> measured;
+        for(uint i = 0; i < queries.size(); i++) {
+            if(images[i].empty() || queryLabels[i] < 0) continue;
+
+            vector<bool> hits(results[m][i].size());
+            for(size_t r = 0; r < hits.size(); r++) {
+                hits[r] = static_cast<int>(documentLabels[results[m][i][r].second]) == queryLabels[i];
+            }
+            Quality q = evaluate(hits, relevant[queryLabels[i]], ranks, numOfResults);
+            s.map += q.averagePrecision;
+            s.ndcg += q.ndcg;
+            for(size_t k = 0; k < ranks.size(); k++) s.precision[k] += q.precision[k];
+            s.overlap += overlap(results[m][i], results[0][i], ranks.back());
+            measured.push_back(latencies[i]);
+            evaluated++;
+        }
+        if(evaluated > 0) {
+            s.map /= evaluated;
+            s.ndcg /= evaluated;
+            s.overlap /= evaluated;
+            for(size_t k = 0; k < ranks.size(); k++) s.precision[k] /= evaluated;
+        }
+        sort(measured.begin(), measured.end());
+        s.meanMs = s.p50Ms = s.p99Ms = 0;
+        if(!measured.empty()) {
+            for(size_t i = 0; i < measured.size(); i++) s.meanMs += measured[i];
+            s.meanMs /= measured.size();
+            s.p50Ms = measured[measured.size() / 2];
+            s.p99Ms = measured[std::min(measured.size() - 1, measured.size() * 99 / 100)];
+        }
+        s.qps = measured.size() / seconds;
+        cout << "mode " << mode.name << ": " << evaluated << " queries evaluated" <<endl;
+    }
+
+    cout << left << setw(32) << "mode" << right << setw(8) << "mAP";
+    for(size_t k = 0; k < ranks.size(); k++) cout << setw(8) << ("P@" + to_string(ranks[k]));
+    cout << setw(8) << "nDCG" << setw(10) << ("ovl@" + to_string(ranks.back()))
+         << setw(10) << "mean ms" << setw(10) << "p99 ms" << setw(10) << "q/s" <<endl;
+    cout << fixed;
+    for(size_t m = 0; m < modes.size(); m++) {
+        const ModeResult &s = summary[m];
+        cout << left << setw(32) << modes[m].name << right << setprecision(4) << setw(8) << s.map;
+        for(size_t k = 0; k < ranks.size(); k++) cout << setw(8) << s.precision[k];
+        cout << setw(8) << s.ndcg << setw(10) << s.overlap << setprecision(2)
+             << setw(10) << s.meanMs << setw(10) << s.p99Ms << setw(10) << s.qps <<endl;
+    }
+    cout.unsetf(ios::fixed);
+
+    if(!outputFile.empty()) {
+        ofstream out(outputFile.c_str());
+        out << "{\"queries\":" << queries.size() << ",\"results\":" << numOfResults << ",\"modes\":[";
+        for(size_t m = 0; m < modes.size(); m++) {
+            const ModeResult &s = summary[m];
+            out << (m > 0 ? "," : "") << "\n{\"name\":\"" << modes[m].name << "\",\"map\":" << s.map << ",\"precision\":{";
+            for(size_t k = 0; k < ranks.size(); k++) out << (k > 0 ? "," : "") << "\"" << ranks[k] << "\":" << s.precision[k];
+            out << "},\"ndcg\":" << s.ndcg << ",\"overlap\":" << s.overlap
+                << ",\"mean_ms\":" << s.meanMs << ",\"p50_ms\":" << s.p50Ms << ",\"p99_ms\":" << s.p99Ms
+                << ",\"qps\":" << s.qps << "}";
+        }
+        out << "\n]}\n";
+    }
+
+    return 0;
+}
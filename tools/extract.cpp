@@ -16,6 +16,8 @@
 **************************************************************************/
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <cstring>
 
 using namespace std;
 
@@ -24,22 +26,42 @@ using namespace std;
 using namespace sse;
 
 void usages() {
-    cout << "Usages: sse extract -f filelist -o output" <<endl
+    cout << "Usages: sse extract -f filelist -o output [-j threads] [-T trace]" <<endl
          << "  This command extracts feature descriptors of images" <<endl
          << "  The options are as follows:" <<endl
          << "  -f\t image \033[4mfilelist\033[0m" <<endl
-         << "  -o\t \033[4moutput\033[0m" <<endl;
+         << "  -o\t \033[4moutput\033[0m" <<endl
+         << "  -j\t number of threads decoding images, default: number of cores" <<endl
+         << "  -T\t write the per stage latency histograms (JSON) to \033[4mtrace\033[0m, needs a build with SSE_TRACE" <<endl;
 }
 
 int main(int argc, char *argv[])
 {
-    if(argc != 5) {
+    if(argc < 5 || argc % 2 == 0) {
+        usages();
+        exit(1);
+    }
+
+    string filelist, outputFile, traceFile;
+    uint numThreads = std::max(1u, std::thread::hardware_concurrency());
+    for(int i = 1; i < argc; i += 2) {
+        if(!strcmp(argv[i], "-f")) filelist = argv[i+1];
+        else if(!strcmp(argv[i], "-o")) outputFile = argv[i+1];
+        else if(!strcmp(argv[i], "-j")) numThreads = std::max(1, atoi(argv[i+1]));
+        else if(!strcmp(argv[i], "-T")) traceFile = argv[i+1];
+        else {
+            usages();
+            exit(1);
+        }
+    }
+
+    if(filelist.empty() || outputFile.empty()) {
         usages();
         exit(1);
     }
 
     FileList files;
-    files.load(argv[2]);
+    files.load(filelist);
 
     Galif *galif = new Galif();
 
@@ -49,16 +71,26 @@ int main(int argc, char *argv[])
     // Don't keep keypoints save memory.
     // std::string kp_file = std::string(argv[4]) + "keypoints";
     // ofstream kp_out(kp_file.c_str());
-    std::string ft_file = std::string(argv[4]);
+    std::string ft_file = outputFile;
     ofstream ft_out(ft_file.c_str());
 
     // kp_out << files.size() << endl;
     ft_out << files.size() << endl;
-    for(uint i = 0; i < files.size(); i++) {
+    // images are decoded on other threads while the features of the previous ones are computed
+    DatasetReader reader(files, galif->width(), numThreads);
+    uint i;
+    cv::Mat image;
+    while(reader.next(i, image)) {
         KeyPoints_t keypoints;
         Features_t features;
-        cv::Mat image = cv::imread(files.getFilename(i));
-        galif->compute(image, keypoints, features);
+        if(image.empty()) {
+            // keep the feature files in line with the filelist, the image gets no features
+            cerr << "can not read " << files.getFilename(i) <<endl;
+            features.create(0, galif->featureLength());
+        }
+        else {
+            galif->compute(image, keypoints, features);
+        }
         // write(keypoints, kp_out);
         write(features, ft_out);
         cout << "Extract descriptors " << i+1 << "/" << files.size() <<"\r" << flush;
@@ -67,6 +99,8 @@ int main(int argc, char *argv[])
 
     // kp_out.close();
     ft_out.close();
+    if(!traceFile.empty())
+        writeTrace(traceFile);
 
     return 0;
 }
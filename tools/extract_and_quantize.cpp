@@ -16,6 +16,8 @@
 **************************************************************************/
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <cstring>
 using namespace std;
 
 #include "opensse/opensse.h"
@@ -23,43 +25,82 @@ using namespace std;
 using namespace sse;
 
 void usages() {
-    cout << "Usages: sse extract_and_quantize -f filelist -v vocabulary -o output" <<endl
+    cout << "Usages: sse extract_and_quantize -f filelist -v vocabulary -o output [-k nearest] [-s sigma] [-j threads] [-T trace]" <<endl
          << "  This command extracts Galif descriptors and quantizes it at the same time" <<endl
          << "  The options are as follows:" <<endl
          << "  -f\t image file list" <<endl
          << "  -v\t \033[4mvocabulary\033[0m" <<endl
-         << "  -o\t \033[4moutput\033[0m samples" <<endl;
+         << "  -o\t \033[4moutput\033[0m samples" <<endl
+         << "  -k\t quantize softly to the \033[4mnearest\033[0m words of each feature, default: 1 (hard quantization)" <<endl
+         << "  -s\t \033[4msigma\033[0m of the soft quantization weights, default: 0.2" <<endl
+         << "  -j\t number of threads decoding images, default: number of cores" <<endl
+         << "  -T\t write the per stage latency histograms (JSON) to \033[4mtrace\033[0m, needs a build with SSE_TRACE" <<endl;
 }
 
 int main(int argc, char *argv[])
 {
-    if(argc != 7) {
+    if(argc < 7 || argc % 2 == 0) {
+        usages();
+        exit(1);
+    }
+
+    string filelist, vocabularyFile, outputFile, traceFile;
+    uint numThreads = std::max(1u, std::thread::hardware_concurrency());
+    uint numOfNearest = 1;
+    float sigma = 0.2;
+    for(int i = 1; i < argc; i += 2) {
+        if(!strcmp(argv[i], "-f")) filelist = argv[i+1];
+        else if(!strcmp(argv[i], "-v")) vocabularyFile = argv[i+1];
+        else if(!strcmp(argv[i], "-o")) outputFile = argv[i+1];
+        else if(!strcmp(argv[i], "-k")) numOfNearest = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-s")) sigma = atof(argv[i+1]);
+        else if(!strcmp(argv[i], "-j")) numThreads = std::max(1, atoi(argv[i+1]));
+        else if(!strcmp(argv[i], "-T")) traceFile = argv[i+1];
+        else {
+            usages();
+            exit(1);
+        }
+    }
+
+    if(filelist.empty() || vocabularyFile.empty() || outputFile.empty() || numOfNearest == 0 || sigma <= 0) {
         usages();
         exit(1);
     }
 
     FileList files;
 
-    files.load(argv[2]);
+    files.load(filelist);
 
     Vocabularys_t vocabulary;
-    read(argv[4], vocabulary, print, "read vocabulary");
+    read(vocabularyFile, vocabulary, print, "read vocabulary");
 
-    //QuantizerHard
     QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > quantizer = QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> >();
+    QuantizerFuzzy<Vec_f32_t, L2norm_squared<Vec_f32_t> > softQuantizer(sigma, numOfNearest);
 
     Galif *galif = new Galif();
 
-    ofstream fout(argv[6]);
+    ofstream fout(outputFile.c_str());
     fout << files.size() <<endl;
     fout << vocabulary.size() <<endl;
-    for(Index_t i = 0; i < files.size(); i++) {
-        Vec_f32_t sample;
-        cv::Mat image = cv::imread(files.getFilename(i));
+    // images are decoded on other threads while the previous ones are quantized
+    DatasetReader reader(files, galif->width(), numThreads);
+    uint i;
+    cv::Mat image;
+    while(reader.next(i, image)) {
+        Vec_f32_t sample(vocabulary.size(), 0);
         KeyPoints_t keypoints;
         Features_t features;
-        galif->compute(image, keypoints, features);
-        quantize(features, vocabulary, sample, quantizer);
+        if(image.empty()) {
+            // keep the samples in line with the filelist, the image gets an empty histogram
+            cerr << "can not read " << files.getFilename(i) <<endl;
+        }
+        else {
+            galif->compute(image, keypoints, features);
+            if(numOfNearest > 1)
+                quantize(features, vocabulary, sample, softQuantizer);
+            else
+                quantize(features, vocabulary, sample, quantizer);
+        }
         for(Index_t j = 0; j < sample.size(); j++) {
             fout << sample[j] << " ";
         }
@@ -69,6 +110,8 @@ int main(int argc, char *argv[])
     cout << "quantize " << files.size() << "/" << files.size() <<"."<<endl;
 
     fout.close();
+    if(!traceFile.empty())
+        writeTrace(traceFile);
     return 0;
 }
 
@@ -0,0 +1,76 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include <iostream>
+#include <thread>
+#include <cstring>
+using namespace std;
+
+#include "opensse/opensse.h"
+
+using namespace sse;
+
+void usages() {
+    cout << "Usages: sse filelist -d rootdir -p pattern -o output [-t format] [-j threads]" <<endl
+         << "  This command lists all image files under \033[4mrootdir\033[0m" <<endl
+         << "  The options are as follows:" <<endl
+         << "  -d\t root directory" <<endl
+         << "  -p\t the file name matches \033[4mpattern\033[0m, eg: \"*.png\"" <<endl
+         << "  -o\t output file" <<endl
+         << "  -t\t output format: text (one path per line, default) or packed (binary, mapped when loaded)" <<endl
+         << "  -j\t number of threads reading directories, default: number of cores" <<endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 7 || argc % 2 == 0) {
+        usages();
+        exit(1);
+    }
+
+    string rootDir, pattern, outputFile;
+    string format = "text";
+    uint numThreads = std::max(1u, std::thread::hardware_concurrency());
+    for(int i = 1; i < argc; i += 2) {
+        if(!strcmp(argv[i], "-d")) rootDir = argv[i+1];
+        else if(!strcmp(argv[i], "-p")) pattern = argv[i+1];
+        else if(!strcmp(argv[i], "-o")) outputFile = argv[i+1];
+        else if(!strcmp(argv[i], "-t")) format = argv[i+1];
+        else if(!strcmp(argv[i], "-j")) numThreads = std::max(1, atoi(argv[i+1]));
+        else {
+            usages();
+            exit(1);
+        }
+    }
+
+    if(rootDir.empty() || pattern.empty() || outputFile.empty()
+            || (format != "text" && format != "packed")) {
+        usages();
+        exit(1);
+    }
+
+    FileList files;
+    try {
+        files.scan(rootDir, pattern, numThreads);
+    }
+    catch(const std::exception &e) {
+        cerr << e.what() << endl;
+        exit(1);
+    }
+    files.store(outputFile, format == "packed");
+    cout << files.size() << " files" << endl;
+    return 0;
+}
@@ -0,0 +1,148 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+#include "opensse/opensse.h"
+
+using namespace sse;
+
+void usages() {
+    cout << "Usages: sse gabor_benchmark -f filelist [-w width] [-n repeat]" <<endl
+         << "  This command compares the frequency and the spatial domain gabor engines of Galif" <<endl
+         << "  The options are as follows:" <<endl
+         << "  -f\t image \033[4mfilelist\033[0m" <<endl
+         << "  -w\t image width the sketches are scaled to, default 256" <<endl
+         << "  -n\t number of times each image is computed, default 3" <<endl;
+}
+
+// ink density buckets, upper bounds in percent of the scaled image
+const double bucketBounds[] = { 2, 5, 10, 20, 100 };
+const uint numBuckets = sizeof(bucketBounds) / sizeof(bucketBounds[0]);
+
+const char* engines[] = { "fft", "spatial", "auto" };
+const uint numEngines = sizeof(engines) / sizeof(engines[0]);
+
+// time of the fastest run in milliseconds
+double timeCompute(const Galif &galif, const cv::Mat &image, uint repeat, Features_t &features)
+{
+    KeyPoints_t keypoints;
+    double best = std::numeric_limits<double>::max();
+    for(uint r = 0; r < repeat; r++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        galif.compute(image, keypoints, features);
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        best = min(best, elapsed.count());
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 3 || argc % 2 == 0) {
+        usages();
+        exit(1);
+    }
+
+    string filelist;
+    uint width = 256;
+    uint repeat = 3;
+    for(int i = 1; i < argc; i += 2) {
+        if(!strcmp(argv[i], "-f")) filelist = argv[i+1];
+        else if(!strcmp(argv[i], "-w")) width = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-n")) repeat = atoi(argv[i+1]);
+        else {
+            usages();
+            exit(1);
+        }
+    }
+
+    if(filelist.empty() || width == 0 || repeat == 0) {
+        usages();
+        exit(1);
+    }
+
+    FileList files;
+    files.load(filelist);
+
+    std::vector<Galif*> galifs;
+    for(uint e = 0; e < numEngines; e++) {
+        galifs.push_back(new Galif(width, 4, 4, 0.1, 0.02, 0.3, 0.1, true, "l2", "stroke", 625, "gaussian", false, engines[e]));
+    }
+
+    vector<vector<double> > times(numBuckets, vector<double>(numEngines, 0));
+    vector<uint> counts(numBuckets, 0);
+    float maxDifference = 0;
+
+    for(uint i = 0; i < files.size(); i++) {
+        cv::Mat image = cv::imread(files.getFilename(i), cv::IMREAD_GRAYSCALE);
+
+        // ink density of the image Galif actually filters
+        cv::Mat scaled;
+        galifs[0]->scale(image, scaled);
+        uint inkPixels = 0;
+        for(int r = 0; r < scaled.rows; r++) {
+            for(int c = 0; c < scaled.cols; c++) {
+                if(scaled.at<unsigned char>(r, c) != 255) inkPixels++;
+            }
+        }
+        double density = 100.0 * inkPixels / scaled.size().area();
+
+        uint b = 0;
+        while(b + 1 < numBuckets && density >= bucketBounds[b]) b++;
+        counts[b]++;
+
+        vector<Features_t> features(numEngines);
+        for(uint e = 0; e < numEngines; e++) {
+            times[b][e] += timeCompute(*galifs[e], image, repeat, features[e]);
+        }
+
+        // both engines should give the same descriptors
+        const Features_t &f = features[0], &s = features[1];
+        for(size_t r = 0; r < min(f.size(), s.size()); r++) {
+            for(size_t c = 0; c < f.cols(); c++) {
+                maxDifference = max(maxDifference, std::fabs(f[r][c] - s[r][c]));
+            }
+        }
+
+        print(i, files.size(), "Benchmark images");
+    }
+
+    cout << "ink density   images";
+    for(uint e = 0; e < numEngines; e++) cout << setw(12) << engines[e];
+    cout << "   (mean ms per image)" <<endl;
+
+    double lower = 0;
+    for(uint b = 0; b < numBuckets; b++) {
+        cout << setw(4) << lower << "-" << setw(3) << bucketBounds[b] << "%  " << setw(8) << counts[b];
+        for(uint e = 0; e < numEngines; e++) {
+            cout << setw(12) << fixed << setprecision(2) << (counts[b] ? times[b][e] / counts[b] : 0.0);
+        }
+        cout.unsetf(ios::fixed);
+        cout << endl;
+        lower = bucketBounds[b];
+    }
+    cout << "max descriptor difference fft/spatial: " << maxDifference <<endl;
+
+    return 0;
+}
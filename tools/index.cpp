@@ -24,7 +24,7 @@ void usages() {
     cout << "Usages: sse index -s samples -o output" <<endl
          << "  This command create index for \033[4msamples\033[0m" <<endl
          << "  The options are as follows:" <<endl
-         << "  -s\t \033[4msamples\033[0m file that has been quantized" <<endl
+         << "  -s\t \033[4msamples\033[0m file that has been quantized (sparse or text format)" <<endl
          << "  -o\t \033[4moutput\033[0m file" <<endl;
 }
 
@@ -35,11 +35,20 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
-    ifstream samples_in(argv[2]);
+    const bool sparse = isSparseHistogramFile(argv[2]);
+
+    ifstream samples_in;
     uint samplesize = 0;
-    samples_in >> samplesize;
     uint vocabularySize = 0;
-    samples_in >> vocabularySize;
+    if(sparse) {
+        samples_in.open(argv[2], ios::binary);
+        readSparseHistogramHeader(samples_in, samplesize, vocabularySize);
+    }
+    else {
+        samples_in.open(argv[2]);
+        samples_in >> samplesize;
+        samples_in >> vocabularySize;
+    }
 
     InvertedIndex index(vocabularySize);
 
@@ -47,12 +56,19 @@ int main(int argc, char* argv[])
 
     cout << "add sample " << "\r" <<std::flush;
     Vec_f32_t sample(vocabularySize);
+    SparseHist_t hist;
     for(uint i = 0; i < samplesize; i++) {
 
-        for(int j = 0; j < vocabularySize; j++) {
-            samples_in >> sample[j];
+        if(sparse) {
+            read(samples_in, hist);
+            index.addSample(hist);
+        }
+        else {
+            for(int j = 0; j < vocabularySize; j++) {
+                samples_in >> sample[j];
+            }
+            index.addSample(sample);
         }
-        index.addSample(sample);
         cout << "add sample " << i <<"/" << samplesize << "\r" <<std::flush;
     }
     cout << "add sample " << samplesize <<"/" << samplesize << "\n" <<std::flush;
@@ -0,0 +1,193 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <sys/resource.h>
+using namespace std;
+
+#include "opensse/opensse.h"
+
+using namespace sse;
+
+void usages() {
+    cout << "Usages: sse ingest -f filelist -v vocabulary -o output [-k nearest] [-s sigma] [-j threads] [-T trace]" <<endl
+         << "  This command extracts, quantizes and indexes images in a single pass," <<endl
+         << "  without writing features or samples files" <<endl
+         << "  The options are as follows:" <<endl
+         << "  -f\t image \033[4mfilelist\033[0m" <<endl
+         << "  -v\t \033[4mvocabulary\033[0m file" <<endl
+         << "  -o\t \033[4moutput\033[0m inverted index file" <<endl
+         << "  -k\t quantize softly to the \033[4mnearest\033[0m words of each feature, default: 1 (hard quantization)" <<endl
+         << "  -s\t \033[4msigma\033[0m of the soft quantization weights, default: 0.2" <<endl
+         << "  -j\t number of threads, default: number of cores" <<endl
+         << "  -T\t write the per stage latency histograms (JSON) to \033[4mtrace\033[0m, needs a build with SSE_TRACE" <<endl;
+}
+
+// Peak resident set size of this process in megabytes
+double peakRssMB()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+    return usage.ru_maxrss / 1024.0; // kilobytes
+#endif
+}
+
+/**
+ * Histograms computed by the workers, handed to the index in file order.
+ * Workers may run at most window images ahead of the index.
+ */
+class ReorderBuffer
+{
+public:
+    ReorderBuffer(uint window) : _slots(window), _ready(window, false), _consumed(0) {}
+
+    // blocks until image i fits into the window
+    void put(uint i, SparseHist_t &hist)
+    {
+        std::unique_lock<std::mutex> locker(_mutex);
+        _changed.wait(locker, [&]() { return i < _consumed + _slots.size(); });
+        _slots[i % _slots.size()].swap(hist);
+        _ready[i % _slots.size()] = true;
+        _changed.notify_all();
+    }
+
+    // blocks until the next image in file order is available
+    void take(SparseHist_t &hist)
+    {
+        std::unique_lock<std::mutex> locker(_mutex);
+        uint slot = _consumed % _slots.size();
+        _changed.wait(locker, [&]() { return _ready[slot]; });
+        hist.swap(_slots[slot]);
+        _ready[slot] = false;
+        _consumed++;
+        _changed.notify_all();
+    }
+
+private:
+    std::vector<SparseHist_t> _slots;
+    std::vector<bool> _ready;
+    uint _consumed;
+    std::mutex _mutex;
+    std::condition_variable _changed;
+};
+
+int main(int argc, char *argv[])
+{
+    if(argc < 7 || argc % 2 == 0) {
+        usages();
+        exit(1);
+    }
+
+    string filelist, vocabularyFile, outputFile, traceFile;
+    uint numThreads = std::max(1u, std::thread::hardware_concurrency());
+    uint numOfNearest = 1;
+    float sigma = 0.2;
+    for(int i = 1; i < argc; i += 2) {
+        if(!strcmp(argv[i], "-f")) filelist = argv[i+1];
+        else if(!strcmp(argv[i], "-v")) vocabularyFile = argv[i+1];
+        else if(!strcmp(argv[i], "-o")) outputFile = argv[i+1];
+        else if(!strcmp(argv[i], "-k")) numOfNearest = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-s")) sigma = atof(argv[i+1]);
+        else if(!strcmp(argv[i], "-j")) numThreads = std::max(1, atoi(argv[i+1]));
+        else if(!strcmp(argv[i], "-T")) traceFile = argv[i+1];
+        else {
+            usages();
+            exit(1);
+        }
+    }
+
+    if(filelist.empty() || vocabularyFile.empty() || outputFile.empty() || numOfNearest == 0 || sigma <= 0) {
+        usages();
+        exit(1);
+    }
+
+    FileList files;
+    files.load(filelist);
+
+    Vocabularys_t vocabulary;
+    read(vocabularyFile, vocabulary, print, "read vocabulary");
+
+    QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > quantizer = QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> >();
+    QuantizerFuzzy<Vec_f32_t, L2norm_squared<Vec_f32_t> > softQuantizer(sigma, numOfNearest);
+
+    // one Galif for all threads, every thread computes in its own workspace
+    const Galif galif;
+
+    InvertedIndex index(vocabulary.size());
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    ReorderBuffer buffer(16 * numThreads);
+    // the decoders stop once 4 decoded images per worker wait, so they take little CPU time from the workers
+    DatasetReader reader(files, galif.width(), numThreads, 4 * numThreads);
+
+    std::vector<std::thread> pools;
+    for(uint t = 0; t < numThreads; t++) {
+        pools.push_back(std::thread([&]() {
+            KeyPoints_t keypoints;
+            Features_t features;
+            SparseHist_t hist;
+            uint i;
+            cv::Mat image;
+            while(reader.next(i, image)) {
+                if(image.empty()) {
+                    // keep the document ids in line with the filelist, the image gets an empty histogram
+                    cerr << "can not read " << files.getFilename(i) <<endl;
+                    hist.clear();
+                }
+                else {
+                    galif.compute(image, keypoints, features);
+                    if(numOfNearest > 1)
+                        quantize(features, vocabulary, hist, softQuantizer);
+                    else
+                        quantize(features, vocabulary, hist, quantizer);
+                }
+                buffer.put(i, hist);
+            }
+        }));
+    }
+
+    SparseHist_t hist;
+    for(uint i = 0; i < files.size(); i++) {
+        buffer.take(hist);
+        index.addSample(hist);
+        print(i, files.size(), "ingest");
+    }
+    for(uint t = 0; t < numThreads; t++) pools[t].join();
+
+    cout << "create index ..." << "\r" <<std::flush;
+    TF_simple tf;
+    IDF_simple idf;
+    index.createIndex(tf, idf);
+    index.save(outputFile);
+
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    cout << "create index done." <<endl;
+    cout << files.size() << " images in " << elapsed.count() << " s, "
+         << files.size() / elapsed.count() << " images/sec, peak RSS " << peakRssMB() << " MB" <<endl;
+    if(!traceFile.empty())
+        writeTrace(traceFile);
+
+    return 0;
+}
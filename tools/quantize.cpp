@@ -16,6 +16,9 @@
 **************************************************************************/
 #include <iostream>
 #include <fstream>
+#include <thread>
+#include <atomic>
+#include <cstring>
 using namespace std;
 
 #include "opensse/opensse.h"
@@ -23,52 +26,154 @@ using namespace std;
 using namespace sse;
 
 void usages() {
-    cout << "Usages: sse quantize -v vocabulary -f features -o output" <<endl
+    cout << "Usages: sse quantize -v vocabulary -f features -o output [-t format] [-k nearest] [-s sigma] [-j threads] [-T trace]" <<endl
          << "  This command quantizes \033[4mfeatures\033[0m with \033[4mvocabulary\033[0m" <<endl
          << "  The options are as follows:" <<endl
          << "  -v\t \033[4mvocabulary\033[0m file" <<endl
          << "  -f\t \033[4mfeatures\033[0m file" <<endl
-         << "  -o\t \033[4moutput\033[0m file" <<endl;
+         << "  -o\t \033[4moutput\033[0m file" <<endl
+         << "  -t\t output format: sparse (binary word/count pairs, default) or text (dense histograms)" <<endl
+         << "  -k\t quantize softly to the \033[4mnearest\033[0m words of each feature, default: 1 (hard quantization)" <<endl
+         << "  -s\t \033[4msigma\033[0m of the soft quantization weights, default: 0.2" <<endl
+         << "  -j\t number of threads, default: number of cores" <<endl
+         << "  -T\t write the per stage latency histograms (JSON) to \033[4mtrace\033[0m, needs a build with SSE_TRACE" <<endl;
+}
+
+// Images read and quantized together, while the next batch is read
+struct Batch
+{
+    std::vector<Features_t> features;
+    std::vector<SparseHist_t> histograms;
+    uint size;
+
+    Batch() : size(0) {}
+};
+
+void readBatch(ifstream &in, uint count, Batch &batch)
+{
+    batch.features.resize(count);
+    batch.histograms.resize(count);
+    for(uint i = 0; i < count; i++) {
+        batch.features[i].clear();
+        read(in, batch.features[i]);
+    }
+    batch.size = count;
+}
+
+template <class Quantizer_t>
+void quantizeBatch(Batch &batch, const Vocabularys_t &vocabulary, uint numThreads, const Quantizer_t &quantizer)
+{
+    std::atomic<uint> next(0);
+    std::vector<std::thread> pools;
+    for(uint t = 0; t < numThreads; t++) {
+        pools.push_back(std::thread([&]() {
+            for(uint i = next++; i < batch.size; i = next++) {
+                quantize(batch.features[i], vocabulary, batch.histograms[i], quantizer);
+            }
+        }));
+    }
+    for(uint t = 0; t < numThreads; t++) pools[t].join();
+}
+
+void writeBatch(const Batch &batch, uint vocabularySize, bool sparse, ofstream &out)
+{
+    for(uint i = 0; i < batch.size; i++) {
+        const SparseHist_t &hist = batch.histograms[i];
+        if(sparse) {
+            write(hist, out);
+            continue;
+        }
+
+        uint k = 0;
+        for(uint j = 0; j < vocabularySize; j++) {
+            if(k < hist.size() && hist[k].first == j) out << hist[k++].second << " ";
+            else out << "0 ";
+        }
+        out << endl;
+    }
 }
 
 int main(int argc, char *argv[])
 {
-    if(argc != 7) {
+    if(argc < 7 || argc % 2 == 0) {
         usages();
         exit(1);
     }
 
-    std::vector<Features_t> vecFeatures;
+    string vocabularyFile, featuresFile, outputFile, traceFile;
+    string format = "sparse";
+    uint numThreads = std::max(1u, std::thread::hardware_concurrency());
+    uint numOfNearest = 1;
+    float sigma = 0.2;
+    for(int i = 1; i < argc; i += 2) {
+        if(!strcmp(argv[i], "-v")) vocabularyFile = argv[i+1];
+        else if(!strcmp(argv[i], "-f")) featuresFile = argv[i+1];
+        else if(!strcmp(argv[i], "-o")) outputFile = argv[i+1];
+        else if(!strcmp(argv[i], "-t")) format = argv[i+1];
+        else if(!strcmp(argv[i], "-k")) numOfNearest = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-s")) sigma = atof(argv[i+1]);
+        else if(!strcmp(argv[i], "-j")) numThreads = std::max(1, atoi(argv[i+1]));
+        else if(!strcmp(argv[i], "-T")) traceFile = argv[i+1];
+        else {
+            usages();
+            exit(1);
+        }
+    }
+
+    if(vocabularyFile.empty() || featuresFile.empty() || outputFile.empty()
+            || (format != "sparse" && format != "text") || numOfNearest == 0 || sigma <= 0) {
+        usages();
+        exit(1);
+    }
+    const bool sparse = format == "sparse";
 
-    ifstream ft_in(argv[4]);
+    ifstream ft_in(featuresFile.c_str());
     uint filesize = 0;
     ft_in >> filesize;
 
     Vocabularys_t vocabulary;
-    read(argv[2], vocabulary, print, "read vocabulary");
+    read(vocabularyFile, vocabulary, print, "read vocabulary");
 
-    //QuantizerHard
     QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > quantizer = QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> >();
+    QuantizerFuzzy<Vec_f32_t, L2norm_squared<Vec_f32_t> > softQuantizer(sigma, numOfNearest);
 
-    ofstream fout(argv[6]);
-    fout << filesize <<endl;
-    fout << vocabulary.size() <<endl;
-
-    for(Index_t i = 0; i < filesize; i++) {
-        Features_t feature;
-        Vec_f32_t sample;
-        read(ft_in, feature);
-        quantize(feature, vocabulary, sample, quantizer);
-        for(Index_t j = 0; j < sample.size(); j++) {
-            fout << sample[j] << " ";
-        }
-        fout << endl;
-        cout << "quantize " << i+1 << "/" << filesize <<"\r"<<flush;
+    ofstream fout;
+    if(sparse) {
+        fout.open(outputFile.c_str(), ios::binary);
+        writeSparseHistogramHeader(fout, filesize, vocabulary.size());
+    }
+    else {
+        fout.open(outputFile.c_str());
+        fout << filesize <<endl;
+        fout << vocabulary.size() <<endl;
+    }
+
+    // quantize one batch while the next one is read,
+    // batches are written in order, so the output order is that of the input
+    const uint batchSize = 16 * numThreads;
+    Batch current, next;
+    uint done = 0;
+    readBatch(ft_in, std::min(batchSize, filesize), current);
+    while(current.size > 0) {
+        uint remaining = filesize - done - current.size;
+        std::thread reader(readBatch, std::ref(ft_in), std::min(batchSize, remaining), std::ref(next));
+
+        if(numOfNearest > 1)
+            quantizeBatch(current, vocabulary, numThreads, softQuantizer);
+        else
+            quantizeBatch(current, vocabulary, numThreads, quantizer);
+        writeBatch(current, vocabulary.size(), sparse, fout);
+        done += current.size;
+
+        reader.join();
+        std::swap(current, next);
+        cout << "quantize " << done << "/" << filesize <<"\r"<<flush;
     }
     cout << "quantize " << filesize << "/" << filesize <<"."<<endl;
 
     fout.close();
     ft_in.close();
+    if(!traceFile.empty())
+        writeTrace(traceFile);
     return 0;
 }
-
@@ -18,75 +18,388 @@
 using namespace std;
 
 #include <fstream>
+#include <sstream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <future>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <csignal>
 
 #include "opensse/opensse.h"
 using namespace sse;
 
+#include "search_protocol.h"
+
 void usages()
 {
-    cout << "Usages: sse search -i indexfile -v vocabulary -f filelist -n resultsnum" <<endl
+    cout << "Usages: sse search -i indexfile -v vocabulary -f filelist -n resultsnum [-l address] [-j threads] [-m connections] [-c entries] [-e seconds] [-k nearest] [-s sigma] [-T trace]" <<endl
          << "OpenSSE search tool in command line"
          << "  The options are as follows:" <<endl
          << "  -i\t inverted index file" <<endl
          << "  -v\t \033[4mvocabulary\033[0m file"<<endl
          << "  -f\t \033[4mfilelist\033[0m"<<endl
-         << "  -n\t the number of results"<<endl;
+         << "  -n\t the number of results"<<endl
+         << "  -l\t serve queries on \033[4maddress\033[0m (localhost TCP port or unix socket path)"<<endl
+         << "    \t instead of reading paths from stdin, see search_protocol.h"<<endl
+         << "  -j\t number of threads running the queries of a server, default: number of cores"<<endl
+         << "  -m\t maximum number of \033[4mconnections\033[0m a server serves at a time, default: 256"<<endl
+         << "  -c\t cache the results of up to \033[4mentries\033[0m recent queries, default: no cache"<<endl
+         << "  -e\t cached results expire after \033[4mseconds\033[0m, default: never"<<endl
+         << "  -k\t quantize queries softly to the \033[4mnearest\033[0m words of each feature, as the index was built,"<<endl
+         << "    \t default: 1 (hard quantization)"<<endl
+         << "  -s\t \033[4msigma\033[0m of the soft quantization weights, default: 0.2"<<endl
+         << "  -T\t write the per stage latency histograms (JSON) to \033[4mtrace\033[0m when the interactive mode exits,"<<endl
+         << "    \t a server answers TRACE requests instead. Needs a build with SSE_TRACE"<<endl;
+}
+
+// A request with its payload, read on the thread of its connection and answered on a query thread
+struct Request
+{
+    string line;
+    // IMAGE: the encoded image
+    std::vector<unsigned char> bytes;
+    // STROKES: one line of points per stroke
+    std::vector<string> strokes;
+};
+
+// Reads the next request and its payload, false once the client closed the connection
+// or broke a limit of the protocol, error then tells which
+bool readRequest(Connection &connection, Request &request, string &error)
+{
+    error.clear();
+    request.bytes.clear();
+    request.strokes.clear();
+    if(!connection.readLine(request.line, MaxRequestLine)) {
+        if(connection.lineTooLong())
+            error = "request line longer than " + to_string(MaxRequestLine) + " bytes";
+        return false;
+    }
+
+    istringstream in(request.line);
+    string type;
+    uint numOfResults = 0;
+    in >> type >> numOfResults;
+    if(type == "IMAGE") {
+        size_t size = 0;
+        in >> size;
+        if(size > MaxRequestBytes) {
+            error = "image larger than " + to_string(MaxRequestBytes) + " bytes";
+            return false;
+        }
+        return connection.readBytes(size, request.bytes);
+    }
+    if(type == "STROKES") {
+        int width = 0, height = 0;
+        float penWidth = 0;
+        size_t numStrokes = 0;
+        if(!(in >> width >> height >> penWidth >> numStrokes))
+            return true; // answered as invalid
+        if(numStrokes > MaxStrokes) {
+            error = "more than " + to_string(MaxStrokes) + " strokes";
+            return false;
+        }
+        request.strokes.resize(numStrokes);
+        size_t remaining = MaxRequestBytes;
+        for(size_t i = 0; i < numStrokes; i++) {
+            if(!connection.readLine(request.strokes[i], remaining)) {
+                if(connection.lineTooLong())
+                    error = "strokes longer than " + to_string(MaxRequestBytes) + " bytes";
+                return false;
+            }
+            remaining -= request.strokes[i].size();
+        }
+    }
+    return true;
+}
+
+// Answers one request of the protocol with one line of JSON
+string handleRequest(Searcher &searcher, uint defaultNumOfResults, const Request &request)
+{
+    istringstream in(request.line);
+    string type;
+    uint numOfResults = 0;
+    in >> type >> numOfResults;
+    if(numOfResults == 0) numOfResults = defaultNumOfResults;
+
+    // results and file names come from the same snapshot, even if a reload publishes a new one
+    // meanwhile. It is taken once the request has been read, a slow client does not hold it
+    Searcher::SnapshotPtr_t snapshot;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    std::vector<ResultItem_t> results;
+    try {
+        if(type == "RELOAD") {
+            bool started = searcher.reloadInBackground();
+            return string("{\"reloading\":") + (started ? "true" : "false") + "}\n";
+        }
+        else if(type == "STATS") {
+            snapshot = searcher.snapshot();
+            const QueryCache *cache = snapshot->cache();
+            ostringstream out;
+            out << "{\"cache\":";
+            if(cache)
+                out << "{\"image_hits\":" << cache->imageHits() << ",\"image_misses\":" << cache->imageMisses()
+                    << ",\"word_hits\":" << cache->wordHits() << ",\"word_misses\":" << cache->wordMisses() << "}";
+            else
+                out << "null";
+            out << "}\n";
+            return out.str();
+        }
+        else if(type == "TRACE") {
+            ostringstream out;
+            out << "{\"trace\":";
+            writeTrace(out);
+            out << "}\n";
+            return out.str();
+        }
+        else if(type == "PATH") {
+            string path;
+            getline(in >> ws, path);
+            snapshot = searcher.snapshot();
+            snapshot->search(path, numOfResults, results);
+        }
+        else if(type == "IMAGE") {
+            snapshot = searcher.snapshot();
+            snapshot->search(request.bytes, numOfResults, results);
+        }
+        else if(type == "STROKES") {
+            cv::Size canvas;
+            float penWidth = 0;
+            size_t numStrokes = 0;
+            in >> canvas.width >> canvas.height >> penWidth >> numStrokes;
+            if(!in || canvas.width <= 0 || canvas.height <= 0)
+                throw std::runtime_error("invalid STROKES request");
+            Strokes_t strokes(request.strokes.size());
+            for(size_t i = 0; i < strokes.size(); i++) {
+                istringstream points(request.strokes[i]);
+                cv::Point2f p;
+                while(points >> p.x >> p.y)
+                    strokes[i].push_back(p);
+            }
+            snapshot = searcher.snapshot();
+            snapshot->search(strokes, canvas, penWidth, numOfResults, results);
+        }
+        else {
+            throw std::runtime_error("unknown request " + type);
+        }
+    }
+    catch(const std::exception &e) {
+        return string("{\"error\":\"") + jsonEscape(e.what()) + "\"}\n";
+    }
+    chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+    ostringstream out;
+    out << "{\"results\":[";
+    for(uint i = 0; i < results.size(); i++) {
+        if(i > 0) out << ",";
+        out << "{\"score\":" << results[i].first
+            << ",\"index\":" << results[i].second
+            << ",\"file\":\"";
+        // root and relative name are written separately, no string per result
+        writeJsonEscaped(out, snapshot->files().rootDir());
+        writeJsonEscaped(out, snapshot->files().getRelativeFilename(results[i].second));
+        out << "\"}";
+    }
+    out << "],\"ms\":" << elapsed.count() << "}\n";
+    return out.str();
+}
+
+// Decrements the number of open connections when the connection thread ends
+struct ConnectionCount
+{
+    std::atomic<uint> &count;
+    explicit ConnectionCount(std::atomic<uint> &count) : count(count) {}
+    ~ConnectionCount() { count--; }
+};
+
+// Fixed number of threads answering requests in the order they were queued
+class QueryPool
+{
+public:
+    QueryPool(Searcher &searcher, uint numOfResults, uint numThreads)
+        : _searcher(searcher), _numOfResults(numOfResults)
+    {
+        for(uint t = 0; t < numThreads; t++) {
+            _threads.push_back(std::thread([this]() {
+                for(;;) {
+                    Job job;
+                    {
+                        std::unique_lock<std::mutex> locker(_mutex);
+                        _available.wait(locker, [this]() { return !_jobs.empty(); });
+                        job = _jobs.front();
+                        _jobs.pop();
+                    }
+                    job.answer->set_value(handleRequest(_searcher, _numOfResults, *job.request));
+                }
+            }));
+        }
+    }
+
+    // the answer to request, which must stay alive until it is there
+    string answer(const Request &request)
+    {
+        std::promise<string> answer;
+        std::future<string> future = answer.get_future();
+        {
+            std::lock_guard<std::mutex> locker(_mutex);
+            Job job = { &request, &answer };
+            _jobs.push(job);
+        }
+        _available.notify_one();
+        return future.get();
+    }
+
+private:
+    struct Job
+    {
+        const Request *request;
+        std::promise<string> *answer;
+    };
+
+    Searcher &_searcher;
+    const uint _numOfResults;
+    std::mutex _mutex;
+    std::condition_variable _available;
+    std::queue<Job> _jobs;
+    std::vector<std::thread> _threads;
+};
+
+// Accepts connections and reads and writes each of them on a thread of its own, the queries
+// themselves run on numThreads query threads. An idle keep-alive client then only costs a
+// sleeping thread, it does not keep a query thread from other clients. Each connection may
+// buffer a request of up to MaxRequestBytes, so at most maxConnections are served at a time,
+// further ones are answered with an error and closed.
+int serve(Searcher &searcher, uint numOfResults, const string &address, uint numThreads, uint maxConnections)
+{
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = listenOn(address);
+    if(listener < 0) {
+        cerr << "can not listen on " << address <<endl;
+        return 1;
+    }
+    cout << ">> serving on " << address << " with " << numThreads << " query threads, at most "
+         << maxConnections << " connections" <<endl;
+
+    QueryPool pool(searcher, numOfResults, numThreads);
+    std::atomic<uint> openConnections(0);
+
+    for(;;) {
+        int fd = accept(listener, NULL, NULL);
+        if(fd < 0) {
+            // e.g. out of file descriptors: give the open connections time to close
+            cerr << "accept failed: " << strerror(errno) <<endl;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+
+        if(openConnections++ >= maxConnections) {
+            openConnections--;
+            // the client may not read, the line fits into the socket buffer anyway
+            const string busy = "{\"error\":\"too many connections\"}\n";
+            send(fd, busy.data(), busy.size(), MSG_DONTWAIT);
+            close(fd);
+            continue;
+        }
+
+        // the pool lives as long as the server, which never returns
+        std::thread([&pool, &openConnections, fd]() {
+            Connection connection(fd);
+            ConnectionCount count(openConnections);
+            Request request;
+            string error;
+            while(readRequest(connection, request, error)) {
+                if(!connection.write(pool.answer(request)))
+                    return;
+            }
+            if(!error.empty())
+                connection.write("{\"error\":\"" + jsonEscape(error) + "\"}\n");
+        }).detach();
+    }
 }
 
 int main(int argc, char *argv[])
 {
-    if(argc != 9) {
+    if(argc < 9 || argc % 2 == 0) {
         usages();
         exit(1);
     }
-    InvertedIndex index;
-    index.load(argv[2]);
-
-    Vocabularys_t vocabulary;
-    read(argv[4], vocabulary, print, "read vocabulary");
-
-    Galif *galif = new Galif();
 
-    QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> > quantizer = QuantizerHard<Vec_f32_t, L2norm_squared<Vec_f32_t> >();
+    string indexFile, vocabularyFile, filelist, address, traceFile;
+    uint numOfResults = 0;
+    uint numThreads = std::max(1u, std::thread::hardware_concurrency());
+    uint maxConnections = 256;
+    uint cacheSize = 0;
+    double cacheTtl = 0;
+    uint numOfNearest = 1;
+    float sigma = 0.2;
+    for(int i = 1; i < argc; i += 2) {
+        if(!strcmp(argv[i], "-i")) indexFile = argv[i+1];
+        else if(!strcmp(argv[i], "-v")) vocabularyFile = argv[i+1];
+        else if(!strcmp(argv[i], "-f")) filelist = argv[i+1];
+        else if(!strcmp(argv[i], "-n")) numOfResults = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-l")) address = argv[i+1];
+        else if(!strcmp(argv[i], "-j")) numThreads = std::max(1, atoi(argv[i+1]));
+        else if(!strcmp(argv[i], "-m")) maxConnections = std::max(1, atoi(argv[i+1]));
+        else if(!strcmp(argv[i], "-c")) cacheSize = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-e")) cacheTtl = atof(argv[i+1]);
+        else if(!strcmp(argv[i], "-k")) numOfNearest = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-s")) sigma = atof(argv[i+1]);
+        else if(!strcmp(argv[i], "-T")) traceFile = argv[i+1];
+        else {
+            usages();
+            exit(1);
+        }
+    }
 
-    TF_simple tf;
-    IDF_simple idf;
+    if(indexFile.empty() || vocabularyFile.empty() || filelist.empty() || numOfResults == 0
+            || numOfNearest == 0 || sigma <= 0) {
+        usages();
+        exit(1);
+    }
 
-    FileList files;
-    files.load(argv[6]);
+    Searcher searcher(indexFile, vocabularyFile, filelist);
+    if(cacheSize > 0)
+        searcher.enableCache(cacheSize, chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(cacheTtl)));
+    if(numOfNearest > 1)
+        searcher.enableSoftQuantization(numOfNearest, sigma);
 
-    uint numOfResults = atoi(argv[8]);
+    if(!address.empty())
+        return serve(searcher, numOfResults, address, numThreads, maxConnections);
 
     cout << ">> sketch search :"<<endl;
     cout << ">> input absolute path, like \"/Users/zdd/zddhub.png\""<<endl;
     cout << ">> type q exit"<<endl;
     cout << ">> good luck!"<<endl;
-    char filename[100];
+    string filename;
     while(true) {
         cout << ">> ";
-        cin >> filename;
-
-        if(filename[0] == 'q' || filename[0] != '/')
+        if(!getline(cin, filename))
             break;
 
-        //extract features
-        KeyPoints_t keypoints;
-        Features_t features;
-        cv::Mat image = cv::imread(filename);
-
-        galif->compute(image, keypoints, features);
-
-        //quantize
-        Vec_f32_t query;
-        quantize(features, vocabulary, query, quantizer);
+        if(filename.empty() || filename[0] == 'q' || filename[0] != '/')
+            break;
 
+        Searcher::SnapshotPtr_t snapshot = searcher.snapshot();
         std::vector<ResultItem_t> results;
-        index.query(query, tf, idf, numOfResults, results);
+        try {
+            snapshot->search(filename, numOfResults, results);
+        }
+        catch(const std::exception &e) {
+            cout << e.what() <<endl;
+            continue;
+        }
 
         for(uint i = 0; i < results.size(); i++) {
-            cout << results[i].first << " " << files.getFilename(results[i].second).c_str()<<endl;
+            cout << results[i].first << " " << snapshot->files().getFilename(results[i].second).c_str()<<endl;
         }
     }
+    if(!traceFile.empty())
+        writeTrace(traceFile);
     return 0;
 }
-
@@ -0,0 +1,139 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <csignal>
+using namespace std;
+
+#include "opensse/opensse.h"
+using namespace sse;
+
+#include "search_protocol.h"
+
+void usages() {
+    cout << "Usages: sse search_load -a address -q queries [-c clients] [-r requests] [-n resultsnum] [-b]" <<endl
+         << "  This command sends queries to a running \"sse search -l address\" and reports latency and throughput" <<endl
+         << "  The options are as follows:" <<endl
+         << "  -a\t server \033[4maddress\033[0m (localhost TCP port or unix socket path)" <<endl
+         << "  -q\t \033[4mfilelist\033[0m of query images, used round robin" <<endl
+         << "  -c\t number of concurrent clients, default 4" <<endl
+         << "  -r\t total number of requests, default 1000" <<endl
+         << "  -n\t number of results per query, default: the server's" <<endl
+         << "  -b\t send the image bytes instead of the paths" <<endl;
+}
+
+int main(int argc, char *argv[])
+{
+    string address, queryList;
+    uint numClients = 4, numRequests = 1000, numOfResults = 0;
+    bool sendBytes = false;
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-b")) { sendBytes = true; continue; }
+        if(i + 1 == argc) { usages(); exit(1); }
+        if(!strcmp(argv[i], "-a")) address = argv[++i];
+        else if(!strcmp(argv[i], "-q")) queryList = argv[++i];
+        else if(!strcmp(argv[i], "-c")) numClients = std::max(1, atoi(argv[++i]));
+        else if(!strcmp(argv[i], "-r")) numRequests = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "-n")) numOfResults = atoi(argv[++i]);
+        else { usages(); exit(1); }
+    }
+
+    if(address.empty() || queryList.empty()) {
+        usages();
+        exit(1);
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    FileList queries;
+    queries.load(queryList);
+    if(queries.size() == 0) {
+        cerr << "no queries in " << queryList <<endl;
+        return 1;
+    }
+
+    // prepare the requests up front, so that only the server is measured
+    std::vector<string> requests(queries.size());
+    for(uint i = 0; i < queries.size(); i++) {
+        ostringstream request;
+        if(sendBytes) {
+            ifstream in(queries.getFilename(i).c_str(), ios::binary);
+            string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+            request << "IMAGE " << numOfResults << " " << bytes.size() << "\n" << bytes;
+        }
+        else {
+            request << "PATH " << numOfResults << " " << queries.getFilename(i) << "\n";
+        }
+        requests[i] = request.str();
+    }
+
+    std::atomic<uint> next(0);
+    std::atomic<uint> errors(0);
+    std::vector<std::vector<double> > latencies(numClients);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    std::vector<std::thread> clients;
+    for(uint c = 0; c < numClients; c++) {
+        clients.push_back(std::thread([&, c]() {
+            int fd = connectTo(address);
+            if(fd < 0) {
+                cerr << "can not connect to " << address <<endl;
+                return;
+            }
+            Connection connection(fd);
+            string response;
+            for(uint i = next++; i < numRequests; i = next++) {
+                chrono::steady_clock::time_point sent = chrono::steady_clock::now();
+                if(!connection.write(requests[i % requests.size()]) || !connection.readLine(response)) {
+                    errors++;
+                    return;
+                }
+                chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - sent;
+                latencies[c].push_back(elapsed.count());
+                if(response.compare(0, 9, "{\"error\":") == 0)
+                    errors++;
+            }
+        }));
+    }
+    for(uint c = 0; c < numClients; c++) clients[c].join();
+
+    chrono::duration<double> total = chrono::steady_clock::now() - start;
+
+    std::vector<double> all;
+    for(uint c = 0; c < numClients; c++) all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+    if(all.empty()) {
+        cerr << "no request succeeded" <<endl;
+        return 1;
+    }
+    std::sort(all.begin(), all.end());
+
+    cout << all.size() << " requests, " << numClients << " clients, " << errors << " errors" <<endl;
+    cout << "QPS " << all.size() / total.count() <<endl;
+    cout << "latency ms p50 " << all[all.size() / 2]
+         << " p99 " << all[std::min(all.size() - 1, all.size() * 99 / 100)]
+         << " max " << all.back() <<endl;
+
+    return 0;
+}
@@ -0,0 +1,237 @@
+/*************************************************************************
+ * Copyright (c) 2014 Zhang Dongdong
+ * All rights reserved.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ * http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+**************************************************************************/
+#ifndef SEARCH_PROTOCOL_H
+#define SEARCH_PROTOCOL_H
+
+// Wire protocol of "sse search -l address" and its load generator "sse search_load".
+//
+// A connection carries any number of requests, one after another:
+//   PATH <number of results> <image path>\n
+//   IMAGE <number of results> <number of bytes>\n<encoded image bytes>
+//   STROKES <number of results> <canvas width> <canvas height> <pen width> <number of strokes>\n
+//     followed by one line "x0 y0 x1 y1 ..." of canvas coordinates per stroke
+//   STATS\n
+//     hit and miss counts of the result cache: {"cache":{"image_hits":...}} or {"cache":null}
+//   TRACE\n
+//     per stage latency histograms and counters, see sse/common/trace.h: {"trace":{"enabled":true,...}}
+//   RELOAD\n
+//     loads the index, vocabulary and filelist again in the background: {"reloading":true}, or false
+//     if a reload is still running. Queries go on meanwhile and use the new files once loaded
+// Every query is answered by one line of JSON:
+//   {"results":[{"score":0.42,"index":17,"file":"..."},...],"ms":12.5}\n
+//   {"error":"..."}\n
+//
+// A request line may be up to MaxRequestLine bytes long, a request may have up to MaxStrokes
+// strokes and MaxRequestBytes bytes of image or stroke lines. Beyond that the server answers
+// {"error":...} and closes the connection, as it can not tell where the next request starts.
+//
+// An address is either a TCP port on localhost ("8080") or the path of a unix domain socket.
+// Programs using Connection should ignore SIGPIPE, a closed peer then shows up as a failed write.
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "opensse/opensse.h"
+
+const size_t MaxRequestLine = 64 << 10;
+const size_t MaxRequestBytes = 64 << 20;
+const size_t MaxStrokes = 100000;
+
+inline bool isTcpAddress(const std::string &address)
+{
+    return !address.empty() && address.find_first_not_of("0123456789") == std::string::npos;
+}
+
+// Opens a socket of the right family for address and fills in the address structure
+inline int openSocket(const std::string &address, sockaddr_storage &storage, socklen_t &length)
+{
+    std::memset(&storage, 0, sizeof(storage));
+    if(isTcpAddress(address)) {
+        sockaddr_in *in = reinterpret_cast<sockaddr_in*>(&storage);
+        in->sin_family = AF_INET;
+        in->sin_port = htons(atoi(address.c_str()));
+        in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        length = sizeof(sockaddr_in);
+        return socket(AF_INET, SOCK_STREAM, 0);
+    }
+
+    sockaddr_un *un = reinterpret_cast<sockaddr_un*>(&storage);
+    un->sun_family = AF_UNIX;
+    std::strncpy(un->sun_path, address.c_str(), sizeof(un->sun_path) - 1);
+    length = sizeof(sockaddr_un);
+    return socket(AF_UNIX, SOCK_STREAM, 0);
+}
+
+// Returns the listening socket, -1 on failure
+inline int listenOn(const std::string &address)
+{
+    sockaddr_storage storage;
+    socklen_t length;
+    int fd = openSocket(address, storage, length);
+    if(fd < 0)
+        return -1;
+
+    if(isTcpAddress(address)) {
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    }
+    else {
+        unlink(address.c_str());
+    }
+
+    if(bind(fd, reinterpret_cast<sockaddr*>(&storage), length) < 0 || listen(fd, 128) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Returns the connected socket, -1 on failure
+inline int connectTo(const std::string &address)
+{
+    sockaddr_storage storage;
+    socklen_t length;
+    int fd = openSocket(address, storage, length);
+    if(fd < 0)
+        return -1;
+
+    if(connect(fd, reinterpret_cast<sockaddr*>(&storage), length) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Buffered reading and writing of one socket, closes it when destroyed
+ */
+class Connection
+{
+public:
+    explicit Connection(int fd) : _fd(fd), _begin(0), _lineTooLong(false) {}
+    ~Connection() { if(_fd >= 0) close(_fd); }
+
+    // reads up to the next newline, which is not stored in line. Fails as well
+    // if the line is longer than maxLength, lineTooLong() then tells so
+    bool readLine(std::string &line, size_t maxLength = std::string::npos)
+    {
+        _lineTooLong = false;
+        for(;;) {
+            size_t end = _buffer.find('\n', _begin);
+            size_t length = (end != std::string::npos ? end : _buffer.size()) - _begin;
+            if(length > maxLength) {
+                _lineTooLong = true;
+                return false;
+            }
+            if(end != std::string::npos) {
+                line.assign(_buffer, _begin, length);
+                _begin = end + 1;
+                return true;
+            }
+            if(!fill())
+                return false;
+        }
+    }
+
+    bool lineTooLong() const { return _lineTooLong; }
+
+    bool readBytes(size_t count, std::vector<unsigned char> &bytes)
+    {
+        while(_buffer.size() - _begin < count) {
+            if(!fill())
+                return false;
+        }
+        bytes.assign(_buffer.begin() + _begin, _buffer.begin() + _begin + count);
+        _begin += count;
+        return true;
+    }
+
+    bool write(const char *data, size_t size)
+    {
+        while(size > 0) {
+            ssize_t written = send(_fd, data, size, 0);
+            if(written <= 0)
+                return false;
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+
+    bool write(const std::string &data) { return write(data.data(), data.size()); }
+
+private:
+    Connection(const Connection&);
+    Connection& operator=(const Connection&);
+
+    bool fill()
+    {
+        // drop what has been consumed before growing the buffer
+        _buffer.erase(0, _begin);
+        _begin = 0;
+
+        char chunk[65536];
+        ssize_t received = recv(_fd, chunk, sizeof(chunk), 0);
+        if(received <= 0)
+            return false;
+        _buffer.append(chunk, received);
+        return true;
+    }
+
+    int _fd;
+    std::string _buffer;
+    size_t _begin;
+    bool _lineTooLong;
+};
+
+// Writes s to out as the content of a JSON string
+inline void writeJsonEscaped(std::ostream &out, sse::StringView s)
+{
+    for(size_t i = 0; i < s.size(); i++) {
+        unsigned char c = s[i];
+        if(c == '"' || c == '\\') {
+            out << '\\' << c;
+        }
+        else if(c < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", c);
+            out << code;
+        }
+        else {
+            out << c;
+        }
+    }
+}
+
+// Escapes s for use inside a JSON string
+inline std::string jsonEscape(const std::string &s)
+{
+    std::ostringstream escaped;
+    writeJsonEscaped(escaped, s);
+    return escaped.str();
+}
+
+#endif // SEARCH_PROTOCOL_H
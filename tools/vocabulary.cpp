@@ -15,6 +15,8 @@
  * limitations under the License.
 **************************************************************************/
 #include <iostream>
+#include <fstream>
+#include <cstring>
 
 using namespace std;
 
@@ -24,17 +26,83 @@ using namespace sse;
 
 void usages()
 {
-    cout << "Usages: sse vocabulary -f features -n numclusters -o output" <<endl
+    cout << "Usages: sse vocabulary -f features -n numclusters -o output [-s seed] [-c compression]" <<endl
          << "  This command generates \033[4mnumclusters\033[0m vocabulary using \033[4mfeatures\033[0m" <<endl
          << "  The options are as follows:" <<endl
          << "  -f\t \033[4mfeatures\033[0m file" <<endl
          << "  -n\t the number of cluster centers"<<endl
-         << "  -o\t \033[4moutput\033[0m file" <<endl;
+         << "  -o\t \033[4moutput\033[0m file" <<endl
+         << "  -s\t random \033[4mseed\033[0m, runs with the same seed give the same vocabulary (optional)" <<endl
+         << "  -c\t keep samples compressed while clustering: none, sq8 (4x less memory) or pq (16x less memory)," <<endl
+         << "    \t the final centers are refined on the exact samples (optional, default none)" <<endl;
+}
+
+// Number of samples the compressed stores are trained on
+const size_t numTrainingSamples = 65536;
+
+// Reads the features file one image at a time, so that only the
+// features of one image have to be held in memory
+template <class Fn>
+void forEachImage(const string &filename, Fn fn, const string &info)
+{
+    ifstream in(filename.c_str());
+    uint size = 0;
+    in >> size;
+    for(uint n = 0; n < size; n++) {
+        Features_t features;
+        read(in, features);
+        fn(features);
+        print(n, size, info);
+    }
+    in.close();
+}
+
+template <class Store>
+void clusterCompressed(const string &filename, uint numclusters, uint seed,
+                       int maxiter, double minChangesfraction, Vocabularys_t &centers)
+{
+    // pick the training samples of the store uniformly (reservoir sampling)
+    Features_t training;
+    size_t seen = 0;
+    Rng_t generator = make_rng(seed);
+    forEachImage(filename, [&](const Features_t &features) {
+        for(size_t i = 0; i < features.size(); i++, seen++) {
+            if(training.size() < numTrainingSamples) {
+                training.push_back(features[i]);
+            } else {
+                size_t k = random_index(generator, seen + 1);
+                if(k < numTrainingSamples) std::copy(features.row(i), features.row(i) + features.cols(), training.row(k));
+            }
+        }
+    }, "read training samples");
+
+    Store store;
+    cout << "train sample store ..." <<endl;
+    store.train(training, seed);
+    Features_t().swap(training);
+
+    forEachImage(filename, [&](const Features_t &features) {
+        store.add(features);
+    }, "compress samples");
+    cout << "compressed " << store.size() << " samples into " << store.memory() << " bytes" <<endl;
+
+    typedef Kmeans<Store, L2norm_squared<Vec_f32_t> > Cluster;
+
+    cout << "cluster ..." <<endl;
+    Cluster cluster(store, numclusters, KmeansInitRandom, L2norm_squared<Vec_f32_t>(), seed);
+    cluster.run(maxiter, minChangesfraction);
+
+    forEachImage(filename, [&](const Features_t &features) {
+        cluster.refine(features);
+    }, "refine on exact samples");
+    cluster.finish_refinement();
+
+    centers = cluster.centers();
 }
 
 int main(int argc, char* argv[])
 {
-    if(argc != 7) {
+    if(argc < 7 || argc % 2 == 0) {
         usages();
         exit(1);
     }
@@ -42,22 +110,54 @@ int main(int argc, char* argv[])
     int maxiter = 20;
     double minChangesfraction = 0.01;
 
-    uint numclusters = atoi(argv[4]);
-    std::cout << numclusters <<endl;
+    string featuresFile, outputFile;
+    string compression = "none";
+    uint numclusters = 0;
+    uint seed = DefaultSeed;
+    for(int i = 1; i < argc; i += 2) {
+        if(!strcmp(argv[i], "-f")) featuresFile = argv[i+1];
+        else if(!strcmp(argv[i], "-n")) numclusters = atoi(argv[i+1]);
+        else if(!strcmp(argv[i], "-o")) outputFile = argv[i+1];
+        else if(!strcmp(argv[i], "-s")) seed = strtoul(argv[i+1], NULL, 10);
+        else if(!strcmp(argv[i], "-c")) compression = argv[i+1];
+        else {
+            usages();
+            exit(1);
+        }
+    }
 
-    Features_t samples;
-    readSamplesForCluster(argv[2], samples, print, "read samples");
+    if(featuresFile.empty() || outputFile.empty() || numclusters == 0) {
+        usages();
+        exit(1);
+    }
 
-    typedef Kmeans<Features_t, L2norm_squared<Vec_f32_t> > Cluster;
+    std::cout << numclusters <<endl;
 
-    cout << "cluster ..." <<endl;
     Vocabularys_t centers;
-    Cluster cluster(samples, numclusters);
-    cluster.run(maxiter, minChangesfraction);
-    centers = cluster.centers();
 
-    write(centers, argv[6], print, "write vocabulary");
+    if(compression == "sq8") {
+        clusterCompressed<SampleStoreSQ8>(featuresFile, numclusters, seed, maxiter, minChangesfraction, centers);
+    }
+    else if(compression == "pq") {
+        clusterCompressed<SampleStorePQ>(featuresFile, numclusters, seed, maxiter, minChangesfraction, centers);
+    }
+    else if(compression == "none") {
+        Features_t samples;
+        readSamplesForCluster(featuresFile, samples, print, "read samples");
+
+        typedef Kmeans<Features_t, L2norm_squared<Vec_f32_t> > Cluster;
+
+        cout << "cluster ..." <<endl;
+        Cluster cluster(samples, numclusters, KmeansInitRandom, L2norm_squared<Vec_f32_t>(), seed);
+        cluster.run(maxiter, minChangesfraction);
+        centers = cluster.centers();
+    }
+    else {
+        usages();
+        exit(1);
+    }
+
+    write(centers, outputFile, print, "write vocabulary");
 
     return 0;
 }
-